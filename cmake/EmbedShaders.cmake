@@ -0,0 +1,32 @@
+# Writes every file in SHADER_DIR into OUTPUT as constexpr string data, see include/rg/ShaderSources.h.
+# Run with: cmake -DSHADER_DIR=<dir> -DSHADER_PREFIX=<path prefix> -DOUTPUT=<header> -P EmbedShaders.cmake
+
+file(GLOB SHADER_FILES RELATIVE "${SHADER_DIR}" "${SHADER_DIR}/*")
+list(SORT SHADER_FILES)
+
+set(CONTENT "// Generated by cmake/EmbedShaders.cmake from ${SHADER_PREFIX}, do not edit.\n\n")
+string(APPEND CONTENT "#ifndef PROJECT_BASE_EMBEDDEDSHADERDATA_H\n#define PROJECT_BASE_EMBEDDEDSHADERDATA_H\n\n")
+string(APPEND CONTENT "namespace rg {\nnamespace embedded {\n\n")
+
+set(TABLE "")
+foreach(SHADER_FILE ${SHADER_FILES})
+    file(READ "${SHADER_DIR}/${SHADER_FILE}" SOURCE)
+    string(FIND "${SOURCE}" ")rgshader\"" DELIMITER_FOUND)
+    if(NOT DELIMITER_FOUND EQUAL -1)
+        message(FATAL_ERROR "${SHADER_FILE} contains the raw string delimiter )rgshader\"")
+    endif()
+    string(MAKE_C_IDENTIFIER "${SHADER_FILE}" NAME)
+    string(APPEND CONTENT "constexpr char ${NAME}[] = R\"rgshader(${SOURCE})rgshader\";\n\n")
+    string(APPEND TABLE "    {\"${SHADER_PREFIX}/${SHADER_FILE}\", ${NAME}, sizeof(${NAME}) - 1, hashSource(${NAME}, sizeof(${NAME}) - 1)},\n")
+endforeach()
+
+string(APPEND CONTENT "constexpr EmbeddedShader shaders[] = {\n${TABLE}};\n\n")
+string(APPEND CONTENT "};\n};\n\n#endif //PROJECT_BASE_EMBEDDEDSHADERDATA_H\n")
+
+# only touch the header when a shader changed, so main.cpp isn't rebuilt needlessly
+if(EXISTS "${OUTPUT}")
+    file(READ "${OUTPUT}" PREVIOUS)
+endif()
+if(NOT "${PREVIOUS}" STREQUAL "${CONTENT}")
+    file(WRITE "${OUTPUT}" "${CONTENT}")
+endif()
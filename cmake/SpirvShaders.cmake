@@ -0,0 +1,55 @@
+# Offline shader check: compiles every shader in resources/shaders to SPIR-V with glslang
+# (OpenGL semantics, -G) and validates the result with spirv-val when it is installed, so
+# GLSL errors fail the build instead of showing up at launch.
+#
+# The .spv files go to ${CMAKE_BINARY_DIR}/spirv, which the executable gets as RG_SPIRV_DIR.
+# lights.vs/fs are loaded from there at runtime (include/rg/SpirvModules.h): their variants are
+# specialization constants, so the one module covers every feature combination.
+
+find_program(GLSLANG_VALIDATOR glslangValidator)
+find_program(SPIRV_VAL spirv-val)
+
+if (NOT GLSLANG_VALIDATOR)
+    message(STATUS "glslangValidator not found, shaders are not checked at build time")
+    return()
+endif()
+
+set(SPIRV_DIR ${CMAKE_BINARY_DIR}/spirv)
+file(GLOB SPIRV_SOURCES "${CMAKE_SOURCE_DIR}/resources/shaders/*.vs" "${CMAKE_SOURCE_DIR}/resources/shaders/*.fs"
+        "${CMAKE_SOURCE_DIR}/resources/shaders/*.gs" "${CMAKE_SOURCE_DIR}/resources/shaders/*.cs")
+
+set(SPIRV_OUTPUTS "")
+foreach(SHADER ${SPIRV_SOURCES})
+    get_filename_component(SHADER_NAME ${SHADER} NAME)
+    get_filename_component(SHADER_EXT ${SHADER} EXT)
+    if (SHADER_EXT STREQUAL ".vs")
+        set(STAGE vert)
+    elseif (SHADER_EXT STREQUAL ".fs")
+        set(STAGE frag)
+    elseif (SHADER_EXT STREQUAL ".cs")
+        set(STAGE comp)
+    else()
+        set(STAGE geom)
+    endif()
+
+    set(OUTPUT ${SPIRV_DIR}/${SHADER_NAME}.spv)
+    set(VALIDATE "")
+    if (SPIRV_VAL)
+        set(VALIDATE COMMAND ${SPIRV_VAL} --target-env opengl4.5 ${OUTPUT})
+    endif()
+    # uniforms and blocks without an explicit location or binding get one assigned (--aml, --amb),
+    # only the shaders loaded at runtime have to declare theirs
+    add_custom_command(
+            OUTPUT ${OUTPUT}
+            COMMAND ${CMAKE_COMMAND} -E make_directory ${SPIRV_DIR}
+            COMMAND ${GLSLANG_VALIDATOR} -G --aml --amb -S ${STAGE} -o ${OUTPUT} ${SHADER}
+            ${VALIDATE}
+            DEPENDS ${SHADER}
+            COMMENT "SPIR-V ${SHADER_NAME}"
+            VERBATIM)
+    list(APPEND SPIRV_OUTPUTS ${OUTPUT})
+endforeach()
+
+add_custom_target(shaders_spirv ALL DEPENDS ${SPIRV_OUTPUTS})
+add_dependencies(${PROJECT_NAME} shaders_spirv)
+target_compile_definitions(${PROJECT_NAME} PRIVATE RG_SPIRV_DIR="${SPIRV_DIR}")
@@ -7,6 +7,17 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <rg/Culling.h>
+#include <rg/GeometryPool.h>
+#include <rg/MeshCache.h>
+#include <rg/MeshOptimizer.h>
+#include <rg/Meshlets.h>
+#include <rg/MeshSimplifier.h>
+#include <rg/MultiDraw.h>
+#include <rg/Profiler.h>
+#include <rg/RenderStats.h>
+#include <rg/ShaderPermutations.h>
+#include <rg/VertexLayout.h>
 
 #include <string>
 #include <vector>
@@ -25,6 +36,36 @@ struct Vertex {
     glm::vec3 Bitangent;
 };
 
+// the vertex in the space of matrix, normalMatrix is its inverse transpose
+inline Vertex TransformVertex(const Vertex &vertex, const glm::mat4 &matrix, const glm::mat3 &normalMatrix)
+{
+    auto direction = [](const glm::vec3 &v) {
+        float length = glm::length(v);
+        return length > 0.0f ? v / length : v;
+    };
+    Vertex result = vertex;
+    result.Position = glm::vec3(matrix * glm::vec4(vertex.Position, 1.0f));
+    result.Normal = direction(normalMatrix * vertex.Normal);
+    result.Tangent = direction(glm::mat3(matrix) * vertex.Tangent);
+    result.Bitangent = direction(glm::mat3(matrix) * vertex.Bitangent);
+    return result;
+}
+
+// position, normal, texture coords, tangent, bitangent
+using VertexFormat = rg::VertexLayout<rg::Float3<0>, rg::Float3<1>, rg::Float2<2>, rg::Float3<3>, rg::Float3<4>>;
+static_assert(VertexFormat::stride == sizeof(Vertex), "VertexFormat doesn't match Vertex");
+static_assert(offsetof(Vertex, Tangent) == 8 * sizeof(float), "VertexFormat doesn't match Vertex");
+// every mesh shares the buffers and the vertex array of one pool
+using MeshGeometryPool = rg::GeometryPool<Vertex, VertexFormat>;
+
+// per-draw data of multi-draw submission, the model matrix at locations 5 to 8
+struct MeshInstance {
+    glm::mat4 model;
+};
+using MeshInstanceFormat = rg::VertexLayout<rg::Float4<5>, rg::Float4<6>, rg::Float4<7>, rg::Float4<8>>;
+static_assert(MeshInstanceFormat::stride == sizeof(MeshInstance), "MeshInstanceFormat doesn't match MeshInstance");
+using MeshDrawList = rg::IndirectDrawList<MeshInstance>;
+
 
 
 struct Texture {
@@ -33,107 +74,263 @@ struct Texture {
     string path;
 };
 
+// Move-only, owns its ranges of the geometry pool.
 class Mesh {
 public:
-    // mesh Data
+    // mesh Data, vertices and indices are empty after the upload unless the mesh retains them
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    // indices of the full detail level, the pool also holds the coarser levels after them
+    unsigned int indexCount = 0;
+    // level 0 is the imported mesh, each further level has about half the triangles
+    vector<rg::LodLevel> lods;
+    // clusters of every level in level order, lodMeshlets[level] is the first of a level and
+    // lodMeshlets[levels] the end
+    vector<rg::Meshlet> meshlets;
+    vector<uint32_t> lodMeshlets;
 
-    unsigned int VAO;
+    MeshGeometryPool::Allocation geometry;
     std::string glslIdentifierPrefix;
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // full sampler uniform name of every texture, e.g. material.texture_diffuse1
+    vector<string> samplerNames;
+    // rg::ShaderFeature bits of the maps this mesh has, selects its shader variant
+    uint32_t shaderFeatures = 0;
+    // equal for meshes with the same textures and features, they share a multi-draw group
+    uint64_t materialKey = 0;
+    // bounding sphere of the vertices in model space, center and radius
+    glm::vec4 bounds = glm::vec4(0.0f);
+    // post-transform cache simulation of the full detail level as imported and as drawn
+    rg::VertexCacheStats importedVertexCache;
+    rg::VertexCacheStats vertexCache;
+    // constructor, takes over the import buffers and optimizes them for the GPU. With
+    // lodLevels > 1 the coarser levels are simplified from the mesh and appended to its indices.
+    Mesh(MeshGeometryPool &pool, vector<Vertex>&& vertices, vector<unsigned int>&& indices, vector<Texture>&& textures,
+         bool retainGeometry = false, unsigned int lodLevels = 1)
+        : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures))
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        computeBounds();
+        prepareGeometry(lodLevels);
+        indexCount = lods[0].indexCount;
+        findLodMeshlets();
+        upload(pool, retainGeometry);
+    }
 
-        // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+    // tag of the constructor for geometry that is optimized already, e.g. by rg::StaticBatch
+    struct Prepared {};
+    // a single detail level with the given meshlets, nothing is reordered
+    Mesh(MeshGeometryPool &pool, Prepared, vector<Vertex>&& vertices, vector<unsigned int>&& indices,
+         vector<Texture>&& textures, vector<rg::Meshlet>&& meshlets, bool retainGeometry = false)
+        : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)),
+          meshlets(std::move(meshlets))
+    {
+        computeBounds();
+        indexCount = (unsigned int)this->indices.size();
+        lods.assign(1, rg::LodLevel{0, indexCount, 0.0f});
+        findLodMeshlets();
+        upload(pool, retainGeometry);
+    }
+
+    void SetShaderTextureNamePrefix(const std::string &prefix)
+    {
+        glslIdentifierPrefix = prefix;
+        updateSamplerNames();
     }
 
     // render the mesh
-    void Draw(Shader &shader)
+    void Draw(Shader &shader) const
+    {
+        BindMaterial(shader);
+        // draw mesh, the vertex array stays bound for the next mesh of the pool
+        if(geometry)
+            pool->draw(geometry, lods[0].firstIndex, lods[0].indexCount);
+    }
+
+    // adds one draw of the mesh to the frame's list, levels past the mesh's last one draw the last.
+    // With clusters every meshlet of the level is a draw of its own, culled on its own.
+    void Queue(MeshDrawList &list, const glm::mat4 &model, unsigned int lod = 0, bool clusters = false) const
+    {
+        if(!geometry)
+            return;
+        size_t levelIndex = std::min<size_t>(lod, lods.size() - 1);
+        const rg::LodLevel &level = lods[levelIndex];
+        if(clusters && clustered(levelIndex))
+        {
+            for(uint32_t i = lodMeshlets[levelIndex]; i < lodMeshlets[levelIndex + 1]; i++)
+            {
+                const rg::Meshlet &meshlet = meshlets[i];
+                list.add(materialKey, this, meshlet.indexCount, geometry.firstIndex + meshlet.firstIndex,
+                         (int32_t)geometry.baseVertex, MeshInstance{model}, rg::transformSphere(model, meshlet.sphere),
+                         rg::transformCone(model, meshlet.cone));
+            }
+            return;
+        }
+        list.add(materialKey, this, level.indexCount, geometry.firstIndex + level.firstIndex, (int32_t)geometry.baseVertex,
+                 MeshInstance{model}, rg::transformSphere(model, bounds));
+    }
+
+    void BindMaterial(Shader &shader) const
     {
         // bind appropriate textures
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
+            // now set the sampler to the correct texture unit
+            rg::gl::Uniform1i(glGetUniformLocation(shader.ID, samplerNames[i].c_str()), i);
+            // and finally bind the texture
+            rg::gl::BindTexture(GL_TEXTURE_2D, textures[i].id);
+        }
+        // always good practice to set everything back to defaults once configured.
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+private:
+    // render data
+    MeshGeometryPool *pool = nullptr;
+
+    // sampler names only change with the prefix, building them in Draw allocated every frame
+    void updateSamplerNames()
+    {
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
+        samplerNames.clear();
+        shaderFeatures = 0;
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
             string name = textures[i].type;
             if(name == "texture_diffuse")
                 number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
+            else if(name == "texture_specular") {
                 number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
+                shaderFeatures |= rg::SHADER_SPECULAR_MAP;
+            }
+            else if(name == "texture_normal") {
                 number = std::to_string(normalNr++); // transfer unsigned int to stream
+                shaderFeatures |= rg::SHADER_NORMAL_MAP;
+            }
             else if(name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            samplerNames.push_back(glslIdentifierPrefix + name + number);
         }
+        materialKey = rg::fnv1a(&shaderFeatures, sizeof(shaderFeatures));
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            materialKey = rg::fnv1a(&textures[i].id, sizeof(textures[i].id), materialKey);
+            materialKey = rg::fnv1a(samplerNames[i], materialKey);
+        }
+    }
 
-
-
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+    void upload(MeshGeometryPool &pool, bool retainGeometry)
+    {
+        // now that we have all the required data, copy it into the pool's buffers
+        setupMesh(pool);
+        updateSamplerNames();
+        // the GPU has its own copy now
+        if(!retainGeometry)
+        {
+            vector<Vertex>().swap(vertices);
+            vector<unsigned int>().swap(indices);
+        }
+    }
+    // sub-allocates the vertices and indices from the pool
+    void setupMesh(MeshGeometryPool &pool)
+    {
+        this->pool = &pool;
+        geometry = pool.allocate(vertices.data(), (uint32_t)vertices.size(), indices.data(), (uint32_t)indices.size());
+    }
+    // the sphere around the box of the vertices, close enough for culling and LOD selection
+    void computeBounds()
+    {
+        if(!vertices.empty())
+        {
+            glm::vec3 lo = vertices[0].Position, hi = vertices[0].Position;
+            for(const Vertex &vertex : vertices)
+            {
+                lo = glm::min(lo, vertex.Position);
+                hi = glm::max(hi, vertex.Position);
+            }
+            glm::vec3 center = (lo + hi) * 0.5f;
+            float radius = 0.0f;
+            for(const Vertex &vertex : vertices)
+                radius = std::max(radius, glm::length(vertex.Position - center));
+            bounds = glm::vec4(center, radius);
+        }
     }
+    // reading a file costs more than optimizing a mesh this small
+    static const size_t MIN_CACHED_INDICES = 3 * 1024;
+    // smaller clusters on average (e.g. a mesh of disconnected quads) cost more as draws than
+    // culling them saves
+    static const uint32_t MIN_MESHLET_TRIANGLES = 16;
 
-private:
-    // render data
-    unsigned int VBO, EBO;
+    bool clustered(size_t level) const
+    {
+        uint32_t count = lodMeshlets[level + 1] - lodMeshlets[level];
+        return count > 1 && lods[level].indexCount >= count * 3 * MIN_MESHLET_TRIANGLES;
+    }
 
-    // initializes all the buffer objects/arrays
-    void setupMesh()
+    // optimizes the imported geometry, or takes the result of an earlier run from rg::MeshCache
+    void prepareGeometry(unsigned int lodLevels)
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-        glBindVertexArray(0);
+        bool cached = indices.size() >= MIN_CACHED_INDICES && rg::MeshCache::enabled();
+        uint64_t key = cached ? rg::MeshCache::key(vertices, indices, lodLevels) : 0;
+        if(cached && rg::MeshCache::load(key, vertices, indices, lods, meshlets, importedVertexCache, vertexCache))
+            return;
+        optimizeGeometry(lodLevels);
+        if(cached)
+            rg::MeshCache::store(key, vertices, indices, lods, meshlets, importedVertexCache, vertexCache);
+    }
+    // Assimp gives every face corner its own vertex, the duplicates are merged first so the
+    // simplifier and the cache optimization see shared vertices. Every level is reordered for
+    // the post-transform cache and then for overdraw, and split into meshlets. The vertices go
+    // last, in the order the full level first uses them.
+    void optimizeGeometry(unsigned int lodLevels)
+    {
+        PROFILE_ZONE("Mesh::optimizeGeometry");
+        importedVertexCache = rg::analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+        rg::deduplicateVertices(vertices, indices);
+        vector<glm::vec3> positions(vertices.size());
+        for(size_t i = 0; i < vertices.size(); i++)
+            positions[i] = vertices[i].Position;
+        generateLods(positions, lodLevels);
+        vector<uint32_t> clusters;
+        for(const rg::LodLevel &level : lods)
+        {
+            rg::optimizeVertexCache(indices.data() + level.firstIndex, level.indexCount, vertices.size(), &clusters);
+            rg::optimizeOverdraw(indices.data() + level.firstIndex, level.indexCount, positions, clusters);
+            size_t first = meshlets.size();
+            rg::buildMeshlets(meshlets, indices.data() + level.firstIndex, level.indexCount, positions);
+            for(size_t i = first; i < meshlets.size(); i++)
+                meshlets[i].firstIndex += level.firstIndex;
+        }
+        rg::optimizeVertexFetch(vertices, indices);
+        vertexCache = rg::analyzeVertexCache(indices.data(), lods[0].indexCount, vertices.size());
+    }
+    // the meshlets of a level are the ones inside its index range
+    void findLodMeshlets()
+    {
+        lodMeshlets.assign(1, 0);
+        uint32_t i = 0;
+        for(const rg::LodLevel &level : lods)
+        {
+            while(i < meshlets.size() && meshlets[i].firstIndex < level.firstIndex + level.indexCount)
+                i++;
+            lodMeshlets.push_back(i);
+        }
+    }
+    // levels that move the surface by more than a quarter of the mesh's size aren't kept
+    void generateLods(const vector<glm::vec3> &positions, unsigned int lodLevels)
+    {
+        if(lodLevels <= 1)
+        {
+            lods.assign(1, rg::LodLevel{0, (uint32_t)indices.size(), 0.0f});
+            return;
+        }
+        PROFILE_ZONE("Mesh::generateLods");
+        lods = rg::MeshSimplifier::generateLods(positions, indices, lodLevels, 0.5f, 0.25f * bounds.w);
     }
 };
 #endif
\ No newline at end of file
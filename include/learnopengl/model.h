@@ -12,6 +12,13 @@
 
 #include <learnopengl/mesh.h>
 #include <learnopengl/shader.h>
+#include <rg/GlObjects.h>
+#include <rg/GpuCulling.h>
+#include <rg/Lod.h>
+#include <rg/Profiler.h>
+#include <rg/RenderStats.h>
+#include <rg/ShaderPermutations.h>
+#include <rg/TextureUploader.h>
 
 #include <string>
 #include <fstream>
@@ -33,11 +40,22 @@ public:
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
-
-    // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    // keep the vertices and indices of the meshes on the CPU after the upload
+    bool retainGeometry;
+    // detail levels generated for every mesh, 1 keeps only the imported meshes
+    unsigned int lodLevels;
+    // per level, the largest error of the meshes in model units
+    vector<float> lodErrors;
+    // bounding sphere of all meshes in model space
+    glm::vec4 bounds = glm::vec4(0.0f);
+
+    // constructor, expects a filepath to a 3D model. The meshes go into the pool, which has to outlive the model.
+    Model(string const &path, MeshGeometryPool &pool, bool gamma = false, bool retainGeometry = false,
+          unsigned int lodLevels = 1)
+        : gammaCorrection(gamma), retainGeometry(retainGeometry), lodLevels(lodLevels), pool(pool)
     {
         loadModel(path);
+        computeLodBounds();
     }
 
     // draws the model, and thus all its meshes
@@ -47,18 +65,49 @@ public:
             meshes[i].Draw(shader);
     }
 
+    // adds a draw of every mesh to the frame's list, see DrawQueued. With clusters the meshlets
+    // are queued and culled on their own (Mesh::Queue).
+    void Queue(MeshDrawList &list, const glm::mat4 &model, bool clusters = false) const
+    {
+        for(const Mesh &mesh : meshes)
+            mesh.Queue(list, model, 0, clusters);
+    }
+
+    // Queues the level the view selects for the model's size on screen, or nothing when it is
+    // too small. lod is the instance's level of the last frame and receives this frame's.
+    void QueueLod(MeshDrawList &list, const glm::mat4 &model, const rg::LodView &view, int &lod,
+                  bool clusters = false) const
+    {
+        glm::vec4 sphere = rg::transformSphere(model, bounds);
+        float scale = bounds.w > 0.0f ? sphere.w / bounds.w : 1.0f;
+        lod = view.select(lodErrors.data(), (unsigned)lodErrors.size(), sphere, scale, lod);
+        if(lod == rg::LOD_CULLED)
+            return;
+        for(const Mesh &mesh : meshes)
+            mesh.Queue(list, model, (unsigned int)lod, clusters);
+    }
+
     void SetShaderTextureNamePrefix(std::string prefix) {
         for (Mesh& mesh: meshes) {
-            mesh.glslIdentifierPrefix = prefix;
+            mesh.SetShaderTextureNamePrefix(prefix);
         }
     }
 private:
+    MeshGeometryPool &pool;
+    // owns the texture names the meshes refer to through textures_loaded
+    vector<rg::GlTexture> textureObjects;
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path)
     {
+        PROFILE_ZONE("Model::loadModel");
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene;
+        {
+            PROFILE_ZONE("Assimp::Importer::ReadFile");
+            scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        }
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
@@ -67,36 +116,79 @@ private:
         }
         // retrieve the directory path of the filepath
         directory = path.substr(0, path.find_last_of('/'));
+        meshes.reserve(scene->mNumMeshes);
 
         // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        processNode(scene->mRootNode, scene, aiMatrix4x4());
+
+        // vertex shader work per triangle and per vertex, before and after the optimization pass
+        rg::VertexCacheStats imported, optimized;
+        for(const Mesh &mesh : meshes)
+        {
+            imported += mesh.importedVertexCache;
+            optimized += mesh.vertexCache;
+        }
+        cout << path << ": " << optimized.vertices << " vertices, " << optimized.triangles << " triangles, ACMR "
+             << imported.acmr() << " -> " << optimized.acmr() << ", ATVR " << imported.atvr() << " -> "
+             << optimized.atvr() << endl;
+    }
+
+    // a mesh with fewer levels draws its last one for the coarser levels of the model
+    void computeLodBounds()
+    {
+        lodErrors.assign(1, 0.0f);
+        for(const Mesh &mesh : meshes)
+            if(mesh.lods.size() > lodErrors.size())
+                lodErrors.resize(mesh.lods.size(), 0.0f);
+        for(const Mesh &mesh : meshes)
+            for(size_t level = 0; level < lodErrors.size(); level++)
+                lodErrors[level] = std::max(lodErrors[level], mesh.lods[std::min(level, mesh.lods.size() - 1)].error);
+        if(meshes.empty())
+            return;
+        glm::vec3 lo = glm::vec3(meshes[0].bounds) - glm::vec3(meshes[0].bounds.w);
+        glm::vec3 hi = glm::vec3(meshes[0].bounds) + glm::vec3(meshes[0].bounds.w);
+        for(const Mesh &mesh : meshes)
+        {
+            lo = glm::min(lo, glm::vec3(mesh.bounds) - glm::vec3(mesh.bounds.w));
+            hi = glm::max(hi, glm::vec3(mesh.bounds) + glm::vec3(mesh.bounds.w));
+        }
+        glm::vec3 center = (lo + hi) * 0.5f;
+        float radius = 0.0f;
+        for(const Mesh &mesh : meshes)
+            radius = std::max(radius, glm::length(glm::vec3(mesh.bounds) - center) + mesh.bounds.w);
+        bounds = glm::vec4(center, radius);
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    // The transforms of the node and its parents are baked into the vertices of its meshes.
+    void processNode(aiNode *node, const aiScene *scene, const aiMatrix4x4 &parentTransform)
     {
+        aiMatrix4x4 transform = parentTransform * node->mTransformation;
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
         {
             // the node object only contains indices to index the actual objects in the scene.
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            meshes.push_back(processMesh(mesh, scene, transform));
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, transform);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    Mesh processMesh(aiMesh *mesh, const aiScene *scene, const aiMatrix4x4 &transform)
     {
+        PROFILE_ZONE("Model::processMesh");
         // data to fill
         vector<Vertex> vertices;
         vector<unsigned int> indices;
         vector<Texture> textures;
+        vertices.reserve(mesh->mNumVertices);
+        indices.reserve(mesh->mNumFaces * 3);
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -140,13 +232,22 @@ private:
                 vertex.TexCoords = glm::vec2(0.0f, 0.0f);
 
             vertices.push_back(vertex);
-
-
+        }
+        if(!transform.IsIdentity())
+        {
+            // assimp's matrices are row-major
+            glm::mat4 matrix;
+            for(int row = 0; row < 4; row++)
+                for(int column = 0; column < 4; column++)
+                    matrix[column][row] = transform[row][column];
+            glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(matrix)));
+            for(Vertex &vertex : vertices)
+                vertex = TransformVertex(vertex, matrix, normalMatrix);
         }
         // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
         for(unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
-            aiFace face = mesh->mFaces[i];
+            const aiFace& face = mesh->mFaces[i];
             // retrieve all indices of the face and store them in the indices vector
             for(unsigned int j = 0; j < face.mNumIndices; j++)
                 indices.push_back(face.mIndices[j]);
@@ -179,7 +280,7 @@ private:
 
 
         // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        return Mesh(pool, std::move(vertices), std::move(indices), std::move(textures), retainGeometry, lodLevels);
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -205,7 +306,8 @@ private:
             if(!skip)
             {   // if texture hasn't been loaded already, load it
                 Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
+                textureObjects.emplace_back(TextureFromFile(str.C_Str(), this->directory));
+                texture.id = textureObjects.back().get();
                 texture.type = typeName;
                 texture.path = str.C_Str();
                 textures.push_back(texture);
@@ -217,43 +319,41 @@ private:
 };
 
 
+// Draws the queued meshes of one pool, one group of equal materials at a time, with the variant of
+// the shader that matches the group's maps. Each group is a single glMultiDrawElementsIndirect
+// where the context has it, otherwise a draw per mesh with the model matrix as a uniform. The list
+// has to be built and uploaded; if culling dispatched for it, the groups draw its survivors.
+void DrawQueued(const MeshDrawList &list, const MeshGeometryPool &pool, rg::ShaderPermutations &permutations,
+                const rg::ShaderVariant &base, const rg::GpuCulling *culling = nullptr)
+{
+    PROFILE_ZONE("DrawQueued");
+    const bool multiDraw = rg::glInfo().multiDrawIndirect;
+    const bool culled = multiDraw && culling && culling->culled();
+    pool.bind();
+    for(uint32_t i = 0; i < (uint32_t)list.groups().size(); i++)
+    {
+        const MeshDrawList::Group &group = list.groups()[i];
+        const Mesh &mesh = *(const Mesh*)group.user;
+        rg::ShaderVariant variant = base;
+        variant.features |= mesh.shaderFeatures;
+        if(multiDraw)
+            variant.features |= rg::SHADER_MULTI_DRAW;
+        Shader &shader = permutations.bind(variant);
+        mesh.BindMaterial(shader);
+        if(culled)
+            culling->submit(list, i);
+        else if(multiDraw)
+            list.submit(group);
+        else
+            list.submitEach(group, [&shader](const MeshInstance &instance) { shader.setMat4("model", instance.model); });
+    }
+}
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
 {
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    // decoded off the render thread, the texels arrive over the next frames
+    return rg::textureUploader().load2D(filename, gamma);
 }
 #endif
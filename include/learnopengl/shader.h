@@ -8,7 +8,16 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstring>
 #include <common.h>
+#include <rg/Profiler.h>
+#include <rg/RenderStats.h>
+#include <rg/ShaderCache.h>
+#include <rg/ShaderSources.h>
+#include <rg/SpirvModules.h>
+#include <rg/UniformBlocks.h>
 class Shader
 {
 public:
@@ -16,162 +25,304 @@ public:
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    : Shader(Deferred(), vertexPath, fragmentPath, geometryPath)
     {
-        std::string vertexPathString(vertexPath);
-        std::string fragmentPathString(fragmentPath);
-
-        vertexPath = vertexPathString.c_str();
-        fragmentPath= fragmentPathString.c_str();
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try 
+        finishLink();
+    }
+    // submits the compile and link without waiting for the driver, errors are checked by the
+    // first use(). rg::ShaderLibrary builds all programs this way so they compile in parallel.
+    // ------------------------------------------------------------------------
+    struct Deferred {};
+    Shader(Deferred, const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr,
+           const std::string& defines = "")
+    {
+        PROFILE_ZONE("Shader::Shader");
+        // 1. retrieve the vertex/fragment source code, embedded in the executable or from filePath
+        rg::ShaderSource vertexSource, fragmentSource, geometrySource;
+        bool sourcesRead = rg::ShaderSources::read(vertexPath, vertexSource)
+                        && rg::ShaderSources::read(fragmentPath, fragmentSource)
+                        && (geometryPath == nullptr || rg::ShaderSources::read(geometryPath, geometrySource));
+        if(!sourcesRead)
         {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
-            // if geometry shader path is present, also load a geometry shader
-            if(geometryPath != nullptr)
-            {
-                std::string geometryPathString(geometryPath);
-                geometryPath = geometryPathString.c_str();
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
-        catch (std::ifstream::failure& e)
+        std::string& vertexCode = vertexSource.text;
+        std::string& fragmentCode = fragmentSource.text;
+        std::string& geometryCode = geometrySource.text;
+        paths[0] = vertexPath;
+        paths[1] = fragmentPath;
+        paths[2] = geometryPath != nullptr ? geometryPath : "";
+        this->defines = defines;
+        if(!defines.empty())
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            vertexCode = injectDefines(vertexCode, defines);
+            fragmentCode = injectDefines(fragmentCode, defines);
+            if(geometryPath != nullptr)
+                geometryCode = injectDefines(geometryCode, defines);
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
+        // 2. reuse the program linked by a previous run if the driver still accepts it
+        cacheKey = rg::ProgramBinaryCache::key({vertexSource.hash, fragmentSource.hash, geometrySource.hash}, defines);
+        ID = rg::ProgramBinaryCache::load(cacheKey);
+        if(ID != 0) {
+            rg::bindUniformBlocks(ID);
+            return;
+        }
+        // 3. compile shaders, the status queries would wait for the compiler so they are left to finishLink()
+        ID = glCreateProgram();
+        stages.push_back(compileStage(GL_VERTEX_SHADER, vertexCode));
+        stages.push_back(compileStage(GL_FRAGMENT_SHADER, fragmentCode));
         if(geometryPath != nullptr)
+            stages.push_back(compileStage(GL_GEOMETRY_SHADER, geometryCode));
+        // shader Program
+        for(unsigned int stage : stages)
+            glAttachShader(ID, stage);
+        rg::ProgramBinaryCache::prepare(ID);
+        glLinkProgram(ID);
+        pending = true;
+    }
+    // vertex/fragment program from the SPIR-V modules of the two files (rg::SpirvModules), deferred
+    // like the above. The defines describe the same variant as the specialization constants, a
+    // rebuild() compiles the GLSL with them.
+    // ------------------------------------------------------------------------
+    struct Spirv {};
+    Shader(Spirv, const char* vertexPath, const char* fragmentPath, const rg::SpirvStage& vertex,
+           const rg::SpirvStage& fragment, const std::string& defines)
+    {
+        PROFILE_ZONE("Shader::Shader");
+        paths[0] = vertexPath;
+        paths[1] = fragmentPath;
+        this->defines = defines;
+        spirv = true;
+        // a SPIR-V program has no names to look up, the locations are the ones the shaders declare
+        for(const rg::glsl::UniformLocation& uniform : rg::glsl::uniformLocations)
         {
-            const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
+            if(uniform.name != nullptr && usesFile(uniform.shader))
+                locations.push_back(uniform);
         }
-        // shader Program
+        // the bindings of the blocks are in the modules already
+        cacheKey = rg::ProgramBinaryCache::key({vertex.hash, fragment.hash}, "#spirv\n" + defines);
+        ID = rg::ProgramBinaryCache::load(cacheKey);
+        if(ID != 0)
+            return;
         ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
+        stages.push_back(rg::SpirvModules::compileStage(GL_VERTEX_SHADER, vertex));
+        stages.push_back(rg::SpirvModules::compileStage(GL_FRAGMENT_SHADER, fragment));
+        for(unsigned int stage : stages)
+            glAttachShader(ID, stage);
+        rg::ProgramBinaryCache::prepare(ID);
+        glLinkProgram(ID);
+        pending = true;
+    }
+    // compute program, deferred like the above. Needs a 4.3 context (rg::glInfo().computeShader).
+    // ------------------------------------------------------------------------
+    struct Compute {};
+    Shader(Compute, const char* computePath, const std::string& defines = "")
+    {
+        PROFILE_ZONE("Shader::Shader");
+        rg::ShaderSource computeSource;
+        if(!rg::ShaderSources::read(computePath, computeSource))
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+        }
+        std::string& computeCode = computeSource.text;
+        paths[0] = computePath;
+        compute = true;
+        this->defines = defines;
+        if(!defines.empty())
+            computeCode = injectDefines(computeCode, defines);
+        cacheKey = rg::ProgramBinaryCache::key({computeSource.hash}, defines);
+        ID = rg::ProgramBinaryCache::load(cacheKey);
+        if(ID != 0) {
+            rg::bindUniformBlocks(ID);
+            return;
+        }
+        ID = glCreateProgram();
+        stages.push_back(compileStage(GL_COMPUTE_SHADER, computeCode));
+        glAttachShader(ID, stages.back());
+        rg::ProgramBinaryCache::prepare(ID);
         glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
+        pending = true;
+    }
+    // true once the driver finished compiling and linking, never waits for it
+    // ------------------------------------------------------------------------
+    bool ready() const
+    {
+        if(!pending)
+            return true;
+        if(!rg::glInfo().parallelShaderCompile)
+            return true;
+        GLint completed = GL_FALSE;
+        glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &completed);
+        return completed == GL_TRUE;
+    }
+    // checks compile and link errors of a deferred program, waits for the driver if it isn't done
+    // ------------------------------------------------------------------------
+    bool finishLink()
+    {
+        if(!pending)
+            return linked;
+        PROFILE_ZONE("Shader::finishLink");
+        pending = false;
+        static const char* stageNames[] = {"VERTEX", "FRAGMENT", "GEOMETRY"};
+        for(size_t i = 0; i < stages.size(); ++i)
+            checkCompileErrors(stages[i], compute ? "COMPUTE" : stageNames[i]);
+        linked = checkCompileErrors(ID, "PROGRAM");
+        if(linked) {
+            if(!spirv)
+                rg::bindUniformBlocks(ID);
+            rg::ProgramBinaryCache::store(cacheKey, ID);
+        } else
+            std::cout << "in program " << paths[0] << std::endl;
         // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
-
+        for(unsigned int stage : stages)
+            glDeleteShader(stage);
+        stages.clear();
+        return linked;
+    }
+    // built from SPIR-V modules, uniforms are looked up in the reflected location table
+    // ------------------------------------------------------------------------
+    bool isSpirv() const
+    {
+        return spirv;
+    }
+    // -1 for uniforms the program doesn't use, like glGetUniformLocation
+    // ------------------------------------------------------------------------
+    int uniformLocation(const char *name) const
+    {
+        if(!spirv)
+            return glGetUniformLocation(ID, name);
+        for(const rg::glsl::UniformLocation& uniform : locations)
+        {
+            if(std::strcmp(uniform.name, name) == 0)
+                return uniform.location;
+        }
+        return -1;
+    }
+    // true if the program is built from the file, compared by name so any path to it matches
+    // ------------------------------------------------------------------------
+    bool usesFile(const std::string& fileName) const
+    {
+        for(const std::string& path : paths)
+        {
+            if(path.size() >= fileName.size() && path.compare(path.size() - fileName.size(), fileName.size(), fileName) == 0
+               && (path.size() == fileName.size() || path[path.size() - fileName.size() - 1] == '/'))
+                return true;
+        }
+        return false;
+    }
+    // submits the same program again from the current sources, used by hot reload. A program
+    // loaded from SPIR-V comes back compiled from GLSL, the modules are only built with the project.
+    // ------------------------------------------------------------------------
+    Shader rebuild() const
+    {
+        if(compute)
+            return Shader(Compute(), paths[0].c_str(), defines);
+        return Shader(Deferred(), paths[0].c_str(), paths[1].c_str(), paths[2].empty() ? nullptr : paths[2].c_str(), defines);
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() 
     { 
-        glUseProgram(ID); 
+        if(pending)
+            finishLink();
+        rg::gl::UseProgram(ID); 
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
+    void setBool(const char *name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        rg::gl::Uniform1i(uniformLocation(name), (int)value); 
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
+    void setInt(const char *name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        rg::gl::Uniform1i(uniformLocation(name), value); 
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
+    void setFloat(const char *name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        rg::gl::Uniform1f(uniformLocation(name), value); 
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
+    void setVec2(const char *name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        rg::gl::Uniform2fv(uniformLocation(name), 1, &value[0]); 
     }
-    void setVec2(const std::string &name, float x, float y) const
+    void setVec2(const char *name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        rg::gl::Uniform2f(uniformLocation(name), x, y); 
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
+    void setVec3(const char *name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        rg::gl::Uniform3fv(uniformLocation(name), 1, &value[0]); 
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
+    void setVec3(const char *name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        rg::gl::Uniform3f(uniformLocation(name), x, y, z); 
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
+    void setVec4(const char *name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        rg::gl::Uniform4fv(uniformLocation(name), 1, &value[0]); 
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w) 
+    void setVec4(const char *name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        rg::gl::Uniform4f(uniformLocation(name), x, y, z, w); 
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    void setMat2(const char *name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        rg::gl::UniformMatrix2fv(uniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    void setMat3(const char *name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        rg::gl::UniformMatrix3fv(uniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    void setMat4(const char *name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        rg::gl::UniformMatrix4fv(uniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    // vertex, fragment and optional geometry source, or only the compute source
+    std::string paths[3];
+    bool compute = false;
+    bool spirv = false;
+    // LOCATION(n) uniforms of the two files when loaded from SPIR-V
+    std::vector<rg::glsl::UniformLocation> locations;
+    std::string defines;
+    std::vector<unsigned int> stages;
+    uint64_t cacheKey = 0;
+    bool pending = false;
+    bool linked = true;
+
+    // #define lines have to follow the #version directive, #line keeps the error line numbers of the file
+    static std::string injectDefines(const std::string& code, const std::string& defines)
+    {
+        size_t version = code.find("#version");
+        if(version == std::string::npos)
+            return defines + "#line 1\n" + code;
+        size_t lineEnd = code.find('\n', version);
+        if(lineEnd == std::string::npos)
+            return code + "\n" + defines;
+        size_t line = std::count(code.begin(), code.begin() + lineEnd, '\n') + 2;
+        return code.substr(0, lineEnd + 1) + defines + "#line " + std::to_string(line) + "\n" + code.substr(lineEnd + 1);
+    }
+
+    static unsigned int compileStage(GLenum type, const std::string& code)
+    {
+        const char* source = code.c_str();
+        unsigned int stage = glCreateShader(type);
+        glShaderSource(stage, 1, &source, NULL);
+        glCompileShader(stage);
+        return stage;
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    bool checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
@@ -193,6 +344,7 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success;
     }
 };
 #endif
@@ -0,0 +1,137 @@
+#ifndef PROJECT_BASE_ALLOCATIONTRACKER_H
+#define PROJECT_BASE_ALLOCATIONTRACKER_H
+
+// Replaces the global operator new/delete with versions that count every heap allocation,
+// per thread and for the whole process. The replacements are defined here, so this header
+// must end up in exactly one translation unit (main.cpp).
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace rg {
+
+struct AllocationCounters {
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    uint64_t bytes = 0;
+};
+
+class AllocationTracker {
+public:
+    static void recordAllocation(size_t size) {
+        ++threadCounters().allocations;
+        threadCounters().bytes += size;
+        allocations().fetch_add(1, std::memory_order_relaxed);
+        bytes().fetch_add(size, std::memory_order_relaxed);
+    }
+
+    static void recordFree() {
+        ++threadCounters().frees;
+        frees().fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // counters of the calling thread since it started
+    static AllocationCounters& threadCounters() {
+        static thread_local AllocationCounters counters;
+        return counters;
+    }
+
+    // counters of all threads since the process started
+    static AllocationCounters processCounters() {
+        AllocationCounters counters;
+        counters.allocations = allocations().load(std::memory_order_relaxed);
+        counters.frees = frees().load(std::memory_order_relaxed);
+        counters.bytes = bytes().load(std::memory_order_relaxed);
+        return counters;
+    }
+
+    // Called once per frame by the render loop, turns the running counters into per frame deltas.
+    static void endFrame() {
+        State& s = state();
+        AllocationCounters process = processCounters();
+        const AllocationCounters& thread = threadCounters();
+        s.lastFrame.allocations = process.allocations - s.processMark.allocations;
+        s.lastFrame.frees = process.frees - s.processMark.frees;
+        s.lastFrame.bytes = process.bytes - s.processMark.bytes;
+        s.lastFrameRenderThread = thread.allocations - s.threadMark.allocations;
+        s.processMark = process;
+        s.threadMark = thread;
+        if (s.lastFrame.allocations > s.worstFrame.allocations)
+            s.worstFrame = s.lastFrame;
+    }
+
+    // all threads, last completed frame
+    static const AllocationCounters& lastFrame() { return state().lastFrame; }
+    // allocations made by the thread that calls endFrame() during the last completed frame
+    static uint64_t lastFrameRenderThread() { return state().lastFrameRenderThread; }
+    static const AllocationCounters& worstFrame() { return state().worstFrame; }
+    static void resetWorstFrame() { state().worstFrame = AllocationCounters(); }
+
+private:
+    struct State {
+        AllocationCounters processMark;
+        AllocationCounters threadMark;
+        AllocationCounters lastFrame;
+        AllocationCounters worstFrame;
+        uint64_t lastFrameRenderThread = 0;
+    };
+
+    static State& state() {
+        static State s;
+        return s;
+    }
+
+    static std::atomic<uint64_t>& allocations() {
+        static std::atomic<uint64_t> counter(0);
+        return counter;
+    }
+    static std::atomic<uint64_t>& frees() {
+        static std::atomic<uint64_t> counter(0);
+        return counter;
+    }
+    static std::atomic<uint64_t>& bytes() {
+        static std::atomic<uint64_t> counter(0);
+        return counter;
+    }
+};
+
+inline void* trackedAllocate(size_t size) {
+    AllocationTracker::recordAllocation(size);
+    return std::malloc(size ? size : 1);
+}
+
+inline void trackedFree(void* p) {
+    if (!p)
+        return;
+    AllocationTracker::recordFree();
+    std::free(p);
+}
+
+};
+
+void* operator new(size_t size) {
+    void* p = rg::trackedAllocate(size);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size) {
+    void* p = rg::trackedAllocate(size);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return rg::trackedAllocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return rg::trackedAllocate(size); }
+void operator delete(void* p) noexcept { rg::trackedFree(p); }
+void operator delete[](void* p) noexcept { rg::trackedFree(p); }
+void operator delete(void* p, size_t) noexcept { rg::trackedFree(p); }
+void operator delete[](void* p, size_t) noexcept { rg::trackedFree(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { rg::trackedFree(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { rg::trackedFree(p); }
+
+#endif //PROJECT_BASE_ALLOCATIONTRACKER_H
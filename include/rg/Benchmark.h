@@ -0,0 +1,189 @@
+#ifndef PROJECT_BASE_BENCHMARK_H
+#define PROJECT_BASE_BENCHMARK_H
+
+#include <rg/SceneGenerator.h>
+#include <rg/GpuTimer.h>
+#include <rg/RenderStats.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rg {
+
+struct BenchmarkResult {
+    SceneConfig config;
+    // rg::cullModeName of the culling the configuration was measured with
+    const char* culling = "off";
+    unsigned int frames = 0;
+    double avgMs = 0.0;
+    double minMs = 0.0;
+    double maxMs = 0.0;
+    double p95Ms = 0.0;
+    // average GPU time of every pass of the GpuProfiler
+    std::vector<std::pair<std::string, double>> gpuPassMs;
+    // render stats summed over the measured frames
+    FrameStats stats;
+    uint64_t statsFrames = 0;
+    // heap allocations per measured frame, steady state frames should not allocate at all
+    double avgAllocations = 0.0;
+    uint64_t maxAllocations = 0;
+};
+
+// Steps through a list of scene configurations, lets each one warm up and then records the
+// frame time of the following frames. The render loop calls frame() once per frame and
+// regenerates the scene whenever it returns true.
+class SceneSweep {
+public:
+    unsigned int warmupFrames = 30;
+    unsigned int measureFrames = 120;
+    // optional, pass timings are averaged over the measured frames
+    GpuProfiler* gpuProfiler = nullptr;
+    // set by the renderer, recorded with each result
+    const char* culling = "off";
+    std::vector<BenchmarkResult> results;
+
+    void start(const std::vector<SceneConfig>& sweepConfigs) {
+        configs = sweepConfigs;
+        measureFrames = std::max(measureFrames, 1u);
+        results.clear();
+        allocations = 0;
+        maxAllocations = 0;
+        current = 0;
+        frameIndex = 0;
+        frameTimes.clear();
+        frameTimes.reserve(measureFrames);
+        active = !configs.empty();
+    }
+
+    bool isActive() const { return active; }
+    const SceneConfig& currentConfig() const { return configs[current]; }
+    size_t currentIndex() const { return current; }
+    size_t size() const { return configs.size(); }
+
+    // returns true when the next configuration has to be loaded
+    bool frame(double frameMs, uint64_t frameAllocations) {
+        if (!active)
+            return false;
+        if (frameIndex == warmupFrames) {
+            RenderStats::resetTotals();
+            if (gpuProfiler)
+                gpuProfiler->resetAverages();
+        }
+        if (frameIndex++ >= warmupFrames) {
+            frameTimes.push_back(frameMs);
+            allocations += frameAllocations;
+            maxAllocations = std::max(maxAllocations, frameAllocations);
+        }
+        if (frameTimes.size() < measureFrames)
+            return false;
+
+        results.push_back(summarize());
+        printResult(results.back());
+        frameTimes.clear();
+        allocations = 0;
+        maxAllocations = 0;
+        frameIndex = 0;
+        if (++current == configs.size()) {
+            active = false;
+            return false;
+        }
+        return true;
+    }
+
+    void writeJson(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out) {
+            std::cerr << "Failed to write benchmark results to " << path << '\n';
+            return;
+        }
+        out << "{\n  \"warmupFrames\": " << warmupFrames
+            << ",\n  \"measureFrames\": " << measureFrames
+            << ",\n  \"results\": [\n";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const BenchmarkResult& r = results[i];
+            out << "    {\"containers\": " << r.config.containers
+                << ", \"rocks\": " << r.config.rocks
+                << ", \"lights\": " << r.config.lights
+                << ", \"windows\": " << r.config.windows
+                << ", \"dragons\": " << r.config.dragons
+                << ", \"seed\": " << r.config.seed
+                << ", \"culling\": \"" << r.culling << '"'
+                << ", \"frames\": " << r.frames
+                << ", \"avgMs\": " << r.avgMs
+                << ", \"minMs\": " << r.minMs
+                << ", \"maxMs\": " << r.maxMs
+                << ", \"p95Ms\": " << r.p95Ms
+                << ", \"avgAllocations\": " << r.avgAllocations
+                << ", \"maxAllocations\": " << r.maxAllocations
+                << ", \"gpuMs\": {";
+            for (size_t j = 0; j < r.gpuPassMs.size(); ++j)
+                out << (j ? ", " : "") << '"' << r.gpuPassMs[j].first << "\": " << r.gpuPassMs[j].second;
+            double frames = r.statsFrames ? (double)r.statsFrames : 1.0;
+            out << "}, \"perFrame\": {\"drawCalls\": " << r.stats.drawCalls / frames
+                << ", \"triangles\": " << r.stats.triangles / frames
+                << ", \"programBinds\": " << r.stats.programBinds / frames
+                << ", \"vertexArrayBinds\": " << r.stats.vertexArrayBinds / frames
+                << ", \"textureBinds\": " << r.stats.textureBinds / frames
+                << ", \"uniformUploads\": " << r.stats.uniformUploads / frames
+                << ", \"bufferBytes\": " << r.stats.bufferBytes / frames
+                << ", \"textureBytes\": " << r.stats.textureBytes / frames;
+            out << "}}" << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n}\n";
+        std::cerr << "Benchmark results written to " << path << '\n';
+    }
+
+private:
+    std::vector<SceneConfig> configs;
+    std::vector<double> frameTimes;
+    uint64_t allocations = 0;
+    uint64_t maxAllocations = 0;
+    size_t current = 0;
+    unsigned int frameIndex = 0;
+    bool active = false;
+
+    BenchmarkResult summarize() {
+        BenchmarkResult result;
+        result.config = configs[current];
+        result.culling = culling;
+        result.frames = (unsigned int)frameTimes.size();
+        double sum = 0.0;
+        for (double t : frameTimes)
+            sum += t;
+        result.avgMs = sum / frameTimes.size();
+        std::sort(frameTimes.begin(), frameTimes.end());
+        result.minMs = frameTimes.front();
+        result.maxMs = frameTimes.back();
+        result.p95Ms = frameTimes[(size_t)(0.95 * (frameTimes.size() - 1))];
+        result.avgAllocations = (double)allocations / frameTimes.size();
+        result.maxAllocations = maxAllocations;
+        result.stats = RenderStats::totals();
+        result.statsFrames = RenderStats::totalFrames();
+        if (gpuProfiler) {
+            for (unsigned int i = 0; i < gpuProfiler->passCount(); ++i)
+                result.gpuPassMs.emplace_back(gpuProfiler->passName(i), gpuProfiler->averageMs(i));
+        }
+        return result;
+    }
+
+    static void printResult(const BenchmarkResult& r) {
+        char line[256];
+        std::snprintf(line, sizeof(line),
+                      "[benchmark] containers=%u rocks=%u lights=%u windows=%u dragons=%u culling=%s"
+                      " avg=%.3fms min=%.3fms max=%.3fms p95=%.3fms gpu=%.3fms allocs/frame=%.1f (max %llu)",
+                      r.config.containers, r.config.rocks, r.config.lights, r.config.windows,
+                      r.config.dragons, r.culling, r.avgMs, r.minMs, r.maxMs, r.p95Ms,
+                      r.gpuPassMs.empty() ? 0.0 : r.gpuPassMs[0].second,
+                      r.avgAllocations, (unsigned long long)r.maxAllocations);
+        std::cout << line << std::endl;
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_BENCHMARK_H
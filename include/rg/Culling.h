@@ -0,0 +1,107 @@
+#ifndef PROJECT_BASE_CULLING_H
+#define PROJECT_BASE_CULLING_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace rg {
+
+enum class CullMode {
+    Off,
+    // bounding spheres against the camera frustum
+    Frustum,
+    // the frustum and the previous frame's depth (Hi-Z pyramid), only on the GPU
+    HiZ,
+};
+
+inline const char* cullModeName(CullMode mode) {
+    switch (mode) {
+        case CullMode::Off: return "off";
+        case CullMode::Frustum: return "frustum";
+        case CullMode::HiZ: return "hiz";
+    }
+    return "off";
+}
+
+inline bool parseCullMode(const std::string& name, CullMode& mode) {
+    for (CullMode candidate : {CullMode::Off, CullMode::Frustum, CullMode::HiZ}) {
+        if (name == cullModeName(candidate)) {
+            mode = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Bounding sphere (center, radius) moved into the space of the matrix, the radius grows with the
+// largest scale. A negative radius marks something that is never culled.
+inline glm::vec4 transformSphere(const glm::mat4& matrix, const glm::vec4& sphere) {
+    if (sphere.w < 0.0f)
+        return sphere;
+    glm::vec3 center = glm::vec3(matrix * glm::vec4(glm::vec3(sphere), 1.0f));
+    float scale = std::max(glm::length(glm::vec3(matrix[0])),
+                           std::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+    return glm::vec4(center, sphere.w * scale);
+}
+
+// Normal cone of a cluster of triangles: axis and cutoff, where cutoff is the sine of the widest
+// angle between the axis and a triangle normal. A cutoff above 1 marks a cone that never culls.
+inline glm::vec4 noCone() { return glm::vec4(0.0f, 0.0f, 0.0f, 2.0f); }
+
+// Moves the cone axis into the space of the matrix, exact for rotations and uniform scales which
+// is what the scene uses.
+inline glm::vec4 transformCone(const glm::mat4& matrix, const glm::vec4& cone) {
+    if (cone.w > 1.0f)
+        return cone;
+    glm::vec3 axis = glm::mat3(matrix) * glm::vec3(cone);
+    float length = glm::length(axis);
+    return length > 0.0f ? glm::vec4(axis / length, cone.w) : noCone();
+}
+
+// Every triangle inside the sphere faces away from eye (the conservative sphere form of the test,
+// as in meshoptimizer). cull.cs does the same test on the GPU. The lit pass draws without
+// GL_CULL_FACE, so this assumes closed meshes wound counter-clockwise: the back of an open mesh
+// would otherwise be seen through its holes.
+inline bool backfacing(const glm::vec4& sphere, const glm::vec4& cone, const glm::vec3& eye) {
+    if (cone.w > 1.0f || sphere.w < 0.0f)
+        return false;
+    glm::vec3 toCenter = glm::vec3(sphere) - eye;
+    return glm::dot(toCenter, glm::vec3(cone)) >= cone.w * glm::length(toCenter) + sphere.w;
+}
+
+// Planes of a view projection matrix, pointing inside and normalized so a sphere test is a dot
+// product per plane. cull.cs does the same test on the GPU.
+struct Frustum {
+    glm::vec4 planes[6];
+
+    Frustum() = default;
+    explicit Frustum(const glm::mat4& viewProjection) {
+        // rows of the column-major matrix (Gribb and Hartmann)
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; ++i)
+            rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+        for (int i = 0; i < 3; ++i) {
+            planes[2 * i] = rows[3] + rows[i];
+            planes[2 * i + 1] = rows[3] - rows[i];
+        }
+        for (glm::vec4& plane : planes)
+            plane /= glm::length(glm::vec3(plane));
+    }
+
+    bool intersects(const glm::vec4& sphere) const {
+        if (sphere.w < 0.0f)
+            return true;
+        for (const glm::vec4& plane : planes) {
+            if (glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w < -sphere.w)
+                return false;
+        }
+        return true;
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_CULLING_H
@@ -0,0 +1,231 @@
+#ifndef PROJECT_BASE_DEBUGOUTPUT_H
+#define PROJECT_BASE_DEBUGOUTPUT_H
+
+#include <glad/glad.h>
+#include <rg/GlExtensions.h>
+#include <rg/ShaderCache.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+
+namespace rg {
+
+// GL_KHR_debug message callback. The driver reports errors and warnings as they happen, so no
+// call has to be followed by a glGetError round trip. Messages below the minimum severity are
+// disabled in the driver, a repeated message is printed once and counted, and messages raised
+// inside GLCALL name its file and line (the callback is synchronous).
+//
+// RG_GL_DEBUG=off|high|medium|low|notification sets the minimum severity, the default is low
+// and off in NDEBUG builds.
+class DebugOutput {
+public:
+    // 0 when off, otherwise one of the GL_DEBUG_SEVERITY_* values; readable before there is a context
+    static GLenum minimumSeverity() {
+        static GLenum severity = []() -> GLenum {
+#ifdef NDEBUG
+            GLenum fallback = 0;
+#else
+            GLenum fallback = GL_DEBUG_SEVERITY_LOW;
+#endif
+            const char* setting = std::getenv("RG_GL_DEBUG");
+            if (!setting)
+                return fallback;
+            std::string value(setting);
+            if (value == "high")
+                return GL_DEBUG_SEVERITY_HIGH;
+            if (value == "medium")
+                return GL_DEBUG_SEVERITY_MEDIUM;
+            if (value == "low")
+                return GL_DEBUG_SEVERITY_LOW;
+            if (value == "notification")
+                return GL_DEBUG_SEVERITY_NOTIFICATION;
+            return 0;
+        }();
+        return severity;
+    }
+
+    // ask for a debug context, some drivers report little or nothing without one
+    static bool requested() { return minimumSeverity() != 0; }
+
+    // call after rg::loadGlExtensions()
+    static bool enable() {
+        if (!requested() || !glInfo().debugOutput)
+            return false;
+        glEnable(GL_DEBUG_OUTPUT);
+        glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+        glDebugMessageCallback(callback, nullptr);
+        const GLenum severities[] = {GL_DEBUG_SEVERITY_NOTIFICATION, GL_DEBUG_SEVERITY_LOW,
+                                     GL_DEBUG_SEVERITY_MEDIUM, GL_DEBUG_SEVERITY_HIGH};
+        for (GLenum severity : severities)
+            glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, severity, 0, nullptr,
+                                  rank(severity) >= rank(minimumSeverity()) ? GL_TRUE : GL_FALSE);
+        // our own debug groups would echo every pass
+        glDebugMessageControl(GL_DEBUG_SOURCE_APPLICATION, GL_DEBUG_TYPE_PUSH_GROUP, GL_DONT_CARE, 0, nullptr, GL_FALSE);
+        glDebugMessageControl(GL_DEBUG_SOURCE_APPLICATION, GL_DEBUG_TYPE_POP_GROUP, GL_DONT_CARE, 0, nullptr, GL_FALSE);
+        state().active = true;
+        return true;
+    }
+
+    static bool active() { return state().active; }
+
+    // prints how often each repeated message was suppressed
+    static void report() {
+        for (const auto& entry : state().repeats)
+            if (entry.second.count > 1)
+                std::cerr << "[OpenGL debug] repeated " << entry.second.count - 1 << " more times: "
+                          << entry.second.message << '\n';
+        state().repeats.clear();
+    }
+
+    // GLCALL marks the call the following messages come from
+    static void beginCall(const char* file, int line, const char* call) {
+        State& s = state();
+        s.file = file;
+        s.line = line;
+        s.call = call;
+        s.callErrors = 0;
+    }
+
+    // errors raised since beginCall
+    static unsigned endCall() {
+        State& s = state();
+        s.file = nullptr;
+        return s.callErrors;
+    }
+
+    // debug groups nest the messages by render pass, see DebugGroup
+    static void pushGroup(const char* name) {
+        State& s = state();
+        if (s.groupDepth < MAX_GROUP_DEPTH)
+            s.groups[s.groupDepth] = name;
+        ++s.groupDepth;
+    }
+    static void popGroup() {
+        if (state().groupDepth > 0)
+            --state().groupDepth;
+    }
+
+private:
+    static const unsigned MAX_GROUP_DEPTH = 8;
+
+    struct Repeat {
+        unsigned count = 0;
+        std::string message;
+    };
+
+    struct State {
+        bool active = false;
+        const char* file = nullptr;
+        int line = 0;
+        const char* call = nullptr;
+        unsigned callErrors = 0;
+        const char* groups[MAX_GROUP_DEPTH] = {};
+        unsigned groupDepth = 0;
+        // synchronous output calls back on the thread that made the GL call, no lock needed
+        std::unordered_map<uint64_t, Repeat> repeats;
+    };
+
+    static State& state() {
+        static State s;
+        return s;
+    }
+
+    static int rank(GLenum severity) {
+        switch (severity) {
+            case GL_DEBUG_SEVERITY_HIGH: return 3;
+            case GL_DEBUG_SEVERITY_MEDIUM: return 2;
+            case GL_DEBUG_SEVERITY_LOW: return 1;
+            default: return 0;
+        }
+    }
+
+    static const char* severityName(GLenum severity) {
+        switch (severity) {
+            case GL_DEBUG_SEVERITY_HIGH: return "high";
+            case GL_DEBUG_SEVERITY_MEDIUM: return "medium";
+            case GL_DEBUG_SEVERITY_LOW: return "low";
+            default: return "notification";
+        }
+    }
+
+    static const char* typeName(GLenum type) {
+        switch (type) {
+            case GL_DEBUG_TYPE_ERROR: return "error";
+            case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated";
+            case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behavior";
+            case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+            case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+            case GL_DEBUG_TYPE_MARKER: return "marker";
+            default: return "other";
+        }
+    }
+
+    static const char* sourceName(GLenum source) {
+        switch (source) {
+            case GL_DEBUG_SOURCE_API: return "API";
+            case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+            case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+            case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+            case GL_DEBUG_SOURCE_APPLICATION: return "application";
+            default: return "other";
+        }
+    }
+
+    static void APIENTRY callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+                                  const GLchar* message, const void* /*userParam*/) {
+        State& s = state();
+        if (type == GL_DEBUG_TYPE_ERROR)
+            ++s.callErrors;
+
+        // the same id can carry different text (object names, sizes), so the text is part of the key
+        size_t size = length >= 0 ? (size_t)length : std::strlen(message);
+        uint64_t key = fnv1a(message, size, ((uint64_t)source << 48) ^ ((uint64_t)type << 32) ^ id);
+        Repeat& repeat = s.repeats[key];
+        if (repeat.count++ > 0)
+            return;
+        repeat.message.assign(message, size);
+
+        std::cerr << "[OpenGL debug] " << severityName(severity) << ' ' << typeName(type) << " from "
+                  << sourceName(source) << " #" << id << ": " << repeat.message << '\n';
+        if (s.groupDepth > 0) {
+            std::cerr << "Pass:";
+            for (unsigned i = 0; i < s.groupDepth && i < MAX_GROUP_DEPTH; ++i)
+                std::cerr << (i ? " / " : " ") << s.groups[i];
+            std::cerr << '\n';
+        }
+        if (s.file)
+            std::cerr << "File: " << s.file << "\nLine: " << s.line << "\nCall: " << s.call << '\n';
+        std::cerr << '\n';
+    }
+};
+
+// Names the commands issued during its lifetime in debuggers and in debug messages.
+class DebugGroup {
+public:
+    explicit DebugGroup(const char* name) {
+        if (!glInfo().debugOutput)
+            return;
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+        DebugOutput::pushGroup(name);
+        pushed = true;
+    }
+    ~DebugGroup() {
+        if (!pushed)
+            return;
+        DebugOutput::popGroup();
+        glPopDebugGroup();
+    }
+
+    DebugGroup(const DebugGroup&) = delete;
+    DebugGroup& operator=(const DebugGroup&) = delete;
+private:
+    bool pushed = false;
+};
+
+};
+
+#endif //PROJECT_BASE_DEBUGOUTPUT_H
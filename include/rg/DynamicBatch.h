@@ -0,0 +1,169 @@
+#ifndef PROJECT_BASE_DYNAMICBATCH_H
+#define PROJECT_BASE_DYNAMICBATCH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <rg/GlObjects.h>
+#include <rg/Profiler.h>
+#include <rg/RenderStats.h>
+#include <rg/StreamBuffer.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// SSE is part of every x86-64 target, RG_NO_SIMD keeps the scalar path
+#if !defined(RG_NO_SIMD) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define RG_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace rg {
+
+// Vertices of a small mesh kept on the CPU, the position in the first three floats of a vertex.
+struct DynamicMesh {
+    const float* vertices;
+    // floats per vertex
+    uint32_t stride;
+    uint32_t vertexCount;
+    // a triangle list of the vertices when null
+    const unsigned int* indices = nullptr;
+    uint32_t indexCount = 0;
+
+    // a batch expands indexed meshes to triangle lists
+    uint32_t drawnVertices() const { return indices ? indexCount : vertexCount; }
+};
+
+// Writes the vertices of the mesh, in draw order, to out with outStride floats each: the position
+// transformed by transform and floats [3, outStride) copied as they are. outStride is at most the
+// mesh's stride, attributes past it are dropped.
+inline void transformVertices(const DynamicMesh& mesh, const glm::mat4& transform, float* out, uint32_t outStride) {
+    const uint32_t count = mesh.drawnVertices();
+#ifdef RG_SSE
+    const __m128 c0 = _mm_loadu_ps(&transform[0][0]);
+    const __m128 c1 = _mm_loadu_ps(&transform[1][0]);
+    const __m128 c2 = _mm_loadu_ps(&transform[2][0]);
+    const __m128 c3 = _mm_loadu_ps(&transform[3][0]);
+#endif
+    for (uint32_t i = 0; i < count; ++i, out += outStride) {
+        const float* v = mesh.vertices + (size_t)(mesh.indices ? mesh.indices[i] : i) * mesh.stride;
+#ifdef RG_SSE
+        __m128 p = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(v[0])), _mm_mul_ps(c1, _mm_set1_ps(v[1]))),
+                              _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(v[2])), c3));
+        // three floats, a 16 byte store would run into the next vertex or past the allocation
+        _mm_storel_pi((__m64*)out, p);
+        _mm_store_ss(out + 2, _mm_movehl_ps(p, p));
+#else
+        glm::vec4 p = transform * glm::vec4(v[0], v[1], v[2], 1.0f);
+        out[0] = p.x;
+        out[1] = p.y;
+        out[2] = p.z;
+#endif
+        for (uint32_t f = 3; f < outStride; ++f)
+            out[f] = v[f];
+    }
+}
+
+// meshes drawing more vertices are left to draws of their own by default
+const uint32_t DYNAMIC_BATCH_MAX_VERTICES = 64;
+
+// Draws copies of small meshes that move, or are too few to be worth a static batch, in one call
+// per material. Every draw() transforms the copies added since the last one into world space on
+// the CPU, writes them to a StreamBuffer and draws each run of copies with the same material from
+// it. For a handful of vertices this beats a draw with a model uniform per copy; above
+// maxVertices the transform costs more than the draws it saves and accepts() turns the mesh away.
+//
+// Layout is the vertex format of the stream (rg::VertexLayout over floats), the shader gets the
+// positions in world space and an identity model matrix. Copies keep the order they were added in,
+// blended ones are drawn as sorted.
+template <typename Layout>
+class DynamicBatch {
+public:
+    uint32_t maxVertices = DYNAMIC_BATCH_MAX_VERTICES;
+
+    void init(StreamBuffer& stream) {
+        this->stream = &stream;
+        vertexArray = GlVertexArray::create();
+        setupGeneration = 0;
+    }
+
+    void destroy() { vertexArray.reset(); }
+
+    bool accepts(const DynamicMesh& mesh) const { return mesh.drawnVertices() <= maxVertices; }
+
+    // the mesh has to stay alive until draw()
+    void add(const DynamicMesh& mesh, const glm::mat4& transform, uint64_t material = 0) {
+        copies.push_back(Copy{&mesh, transform, material});
+        vertexCount += mesh.drawnVertices();
+    }
+
+    // bindMaterial(material) is called before the draw of each run
+    template <typename BindMaterial>
+    void draw(BindMaterial bindMaterial, GLenum mode = GL_TRIANGLES) {
+        drawnCopies = copies.size();
+        draws = 0;
+        if (copies.empty())
+            return;
+        PROFILE_ZONE("DynamicBatch::draw");
+        const uint32_t floats = (uint32_t)(Layout::stride / sizeof(float));
+        StreamBuffer::Allocation allocation = stream->allocate((size_t)vertexCount * Layout::stride, Layout::stride);
+        {
+            PROFILE_ZONE("Transform vertices");
+            float* out = (float*)allocation.data;
+            for (const Copy& copy : copies) {
+                transformVertices(*copy.mesh, copy.transform, out, floats);
+                out += (size_t)copy.mesh->drawnVertices() * floats;
+            }
+        }
+        stream->flush();
+
+        gl::BindVertexArray(vertexArray.get());
+        if (setupGeneration != stream->generation()) {
+            Layout::setup(stream->buffer());
+            setupGeneration = stream->generation();
+        }
+        GLint first = (GLint)(allocation.offset / Layout::stride);
+        for (size_t run = 0; run < copies.size();) {
+            GLsizei count = 0;
+            size_t end = run;
+            for (; end < copies.size() && copies[end].material == copies[run].material; ++end)
+                count += (GLsizei)copies[end].mesh->drawnVertices();
+            bindMaterial(copies[run].material);
+            gl::DrawArrays(mode, first, count);
+            ++draws;
+            first += count;
+            run = end;
+        }
+        copies.clear();
+        vertexCount = 0;
+    }
+
+    void draw(GLenum mode = GL_TRIANGLES) {
+        draw([](uint64_t) {}, mode);
+    }
+
+    // copies in the last draw() and the calls it took, each copy would have been a draw of its own.
+    // A draw() without copies draws nothing and resets them.
+    size_t copyCount() const { return drawnCopies; }
+    size_t drawCount() const { return draws; }
+
+private:
+    struct Copy {
+        const DynamicMesh* mesh;
+        glm::mat4 transform;
+        uint64_t material;
+    };
+
+    StreamBuffer* stream = nullptr;
+    GlVertexArray vertexArray;
+    // stream buffer the vertex array points at, the stream replaces it when it grows
+    uint64_t setupGeneration = 0;
+    std::vector<Copy> copies;
+    size_t vertexCount = 0;
+    size_t drawnCopies = 0;
+    size_t draws = 0;
+};
+
+};
+
+#endif //PROJECT_BASE_DYNAMICBATCH_H
@@ -7,12 +7,19 @@
 
 #include <iostream>
 #include <glad/glad.h>
+#include <rg/DebugOutput.h>
 
 #define LOG(stream) stream << "[" << __FILE__ << ", " << __func__ << ", " << __LINE__ << "] "
 #define BREAK_IF_FALSE(x) if (!(x)) __builtin_trap()
 #define ASSERT(x, msg) do { if (!(x)) { std::cerr << msg << '\n'; BREAK_IF_FALSE(false); } } while(0)
+// Checked GL call. With debug output the driver reports the error through the callback, otherwise
+// the error flags are polled; release builds make the call unchecked.
+#ifdef NDEBUG
+#define GLCALL(x) x
+#else
 #define GLCALL(x) \
-do{ rg::clearAllOpenGlErrors(); x; BREAK_IF_FALSE(rg::wasPreviousOpenGLCallSuccessful(__FILE__, __LINE__, #x)); } while (0)
+do{ rg::beginOpenGLCall(__FILE__, __LINE__, #x); x; BREAK_IF_FALSE(rg::endOpenGLCall(__FILE__, __LINE__, #x)); } while (0)
+#endif
 
 namespace rg {
 
@@ -20,6 +27,8 @@ namespace rg {
 void clearAllOpenGlErrors();
 const char* openGLErrorToString(GLenum error);
 bool wasPreviousOpenGLCallSuccessful(const char* file, int line, const char* call);
+void beginOpenGLCall(const char* file, int line, const char* call);
+bool endOpenGLCall(const char* file, int line, const char* call);
 
     void clearAllOpenGlErrors() {
         while (glGetError() != GL_NO_ERROR) {
@@ -49,6 +58,17 @@ bool wasPreviousOpenGLCallSuccessful(const char* file, int line, const char* cal
         }
         return success;
     }
+    void beginOpenGLCall(const char* file, int line, const char* call) {
+        if (DebugOutput::active())
+            DebugOutput::beginCall(file, line, call);
+        else
+            clearAllOpenGlErrors();
+    }
+    bool endOpenGLCall(const char* file, int line, const char* call) {
+        if (DebugOutput::active())
+            return DebugOutput::endCall() == 0;
+        return wasPreviousOpenGLCallSuccessful(file, line, call);
+    }
 
 };
 #endif //PROJECT_BASE_ERROR_H
@@ -0,0 +1,172 @@
+#ifndef PROJECT_BASE_GEOMETRYPOOL_H
+#define PROJECT_BASE_GEOMETRYPOOL_H
+
+#include <glad/glad.h>
+#include <rg/GlObjects.h>
+#include <rg/RangeAllocator.h>
+#include <rg/RenderStats.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+namespace rg {
+
+// Shared vertex and index buffer of one vertex format. Meshes get a range of each and are drawn
+// with glDrawElementsBaseVertex from the pool's single vertex array, so switching meshes doesn't
+// switch buffers. Indices stay relative to the mesh's first vertex. The buffers are created on
+// the first allocation and double (copied on the GPU) when they run out of space.
+template <typename Vertex, typename Layout>
+class GeometryPool {
+public:
+    // A mesh's ranges, returned to the pool when the allocation goes away.
+    class Allocation {
+    public:
+        Allocation() = default;
+        ~Allocation() { reset(); }
+
+        Allocation(Allocation&& other) noexcept { *this = std::move(other); }
+        Allocation& operator=(Allocation&& other) noexcept {
+            if (this != &other) {
+                reset();
+                pool = other.pool;
+                baseVertex = other.baseVertex;
+                vertexCount = other.vertexCount;
+                firstIndex = other.firstIndex;
+                indexCount = other.indexCount;
+                other.pool = nullptr;
+            }
+            return *this;
+        }
+        Allocation(const Allocation&) = delete;
+        Allocation& operator=(const Allocation&) = delete;
+
+        void reset() {
+            if (pool)
+                pool->release(*this);
+            pool = nullptr;
+        }
+
+        explicit operator bool() const { return pool != nullptr; }
+
+        uint32_t baseVertex = 0;
+        uint32_t vertexCount = 0;
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+    private:
+        friend class GeometryPool;
+        GeometryPool* pool = nullptr;
+    };
+
+    explicit GeometryPool(uint32_t initialVertices = 1 << 16, uint32_t initialIndices = 1 << 18)
+    : initialVertices(initialVertices), initialIndices(initialIndices) {}
+
+    GeometryPool(const GeometryPool&) = delete;
+    GeometryPool& operator=(const GeometryPool&) = delete;
+
+    Allocation allocate(const Vertex* vertexData, uint32_t vertexCount, const uint32_t* indexData, uint32_t indexCount) {
+        if (vertexCount == 0 || indexCount == 0)
+            return Allocation();
+        if (!vao) {
+            vao = GlVertexArray::create();
+            gl::BindVertexArray(vao.get());
+            growVertices(initialVertices);
+            growIndices(initialIndices);
+        }
+        Allocation allocation;
+        allocation.baseVertex = vertexRanges.allocate(vertexCount);
+        if (allocation.baseVertex == RangeAllocator::INVALID) {
+            growVertices(std::max(vertexRanges.capacity() * 2, vertexRanges.capacity() + vertexCount));
+            allocation.baseVertex = vertexRanges.allocate(vertexCount);
+        }
+        allocation.firstIndex = indexRanges.allocate(indexCount);
+        if (allocation.firstIndex == RangeAllocator::INVALID) {
+            growIndices(std::max(indexRanges.capacity() * 2, indexRanges.capacity() + indexCount));
+            allocation.firstIndex = indexRanges.allocate(indexCount);
+        }
+        allocation.vertexCount = vertexCount;
+        allocation.indexCount = indexCount;
+        allocation.pool = this;
+
+        // the copy targets leave the vertex array's element buffer alone
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vertices.get());
+        gl::BufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)allocation.baseVertex * sizeof(Vertex),
+                          (GLsizeiptr)vertexCount * sizeof(Vertex), vertexData);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, indices.get());
+        gl::BufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)allocation.firstIndex * sizeof(uint32_t),
+                          (GLsizeiptr)indexCount * sizeof(uint32_t), indexData);
+        return allocation;
+    }
+
+    void bind() const { gl::BindVertexArray(vao.get()); }
+
+    // per-instance attributes of every draw from the pool, e.g. the instance buffer of an
+    // IndirectDrawList; they use their own binding index
+    template <typename InstanceLayout>
+    void attachInstances(GLuint buffer, GLuint binding = 1) {
+        bind();
+        InstanceLayout::setup(buffer, binding, 1);
+    }
+
+    void draw(const Allocation& allocation, GLenum mode = GL_TRIANGLES) const {
+        draw(allocation, 0, allocation.indexCount, mode);
+    }
+
+    // part of the allocation's indices, firstIndex relative to its start (e.g. one LOD level)
+    void draw(const Allocation& allocation, uint32_t firstIndex, uint32_t indexCount, GLenum mode = GL_TRIANGLES) const {
+        bind();
+        gl::DrawElementsBaseVertex(mode, indexCount, GL_UNSIGNED_INT,
+                                   (const void*)((size_t)(allocation.firstIndex + firstIndex) * sizeof(uint32_t)),
+                                   (GLint)allocation.baseVertex);
+    }
+
+    GLuint vertexArray() const { return vao.get(); }
+    GLuint vertexBuffer() const { return vertices.get(); }
+    GLuint indexBuffer() const { return indices.get(); }
+    const RangeAllocator& vertexAllocator() const { return vertexRanges; }
+    const RangeAllocator& indexAllocator() const { return indexRanges; }
+
+private:
+    uint32_t initialVertices;
+    uint32_t initialIndices;
+    GlVertexArray vao;
+    GlBuffer vertices;
+    GlBuffer indices;
+    RangeAllocator vertexRanges;
+    RangeAllocator indexRanges;
+
+    void release(const Allocation& allocation) {
+        vertexRanges.free(allocation.baseVertex, allocation.vertexCount);
+        indexRanges.free(allocation.firstIndex, allocation.indexCount);
+    }
+
+    // new buffer with the old contents, the allocations keep their offsets
+    GlBuffer resized(const GlBuffer& old, size_t oldBytes, size_t newBytes) {
+        GlBuffer buffer = GlBuffer::create();
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer.get());
+        gl::BufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)newBytes, nullptr, GL_STATIC_DRAW);
+        if (old && oldBytes > 0) {
+            glBindBuffer(GL_COPY_READ_BUFFER, old.get());
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (GLsizeiptr)oldBytes);
+        }
+        return buffer;
+    }
+
+    void growVertices(uint32_t capacity) {
+        vertices = resized(vertices, (size_t)vertexRanges.capacity() * sizeof(Vertex), (size_t)capacity * sizeof(Vertex));
+        vertexRanges.grow(capacity);
+        gl::BindVertexArray(vao.get());
+        Layout::setup(vertices.get());
+    }
+
+    void growIndices(uint32_t capacity) {
+        indices = resized(indices, (size_t)indexRanges.capacity() * sizeof(uint32_t), (size_t)capacity * sizeof(uint32_t));
+        indexRanges.grow(capacity);
+        gl::BindVertexArray(vao.get());
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices.get());
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_GEOMETRYPOOL_H
@@ -0,0 +1,274 @@
+#ifndef PROJECT_BASE_GLEXTENSIONS_H
+#define PROJECT_BASE_GLEXTENSIONS_H
+
+// glad in libs/ is generated for core 3.3 only. Entry points of newer versions and extensions
+// are declared and loaded here, each block is skipped once glad is regenerated with them.
+// Call rg::loadGlExtensions() right after gladLoadGLLoader() and check rg::glInfo() before use.
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <set>
+#include <string>
+
+// A function static behind an inline accessor, so every translation unit including this header
+// shares the one pointer loadGlExtensions() sets. The gl* macros call the accessor.
+#define RG_GL_ENTRY_POINT(type, name) \
+    inline type& name() {             \
+        static type entry = nullptr;  \
+        return entry;                 \
+    }
+
+#ifndef GL_VERSION_4_1
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#define GL_PROGRAM_BINARY_FORMATS 0x87FF
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP PFNGLSHADERBINARYPROC)(GLsizei count, const GLuint *shaders, GLenum binaryformat, const void *binary, GLsizei length);
+RG_GL_ENTRY_POINT(PFNGLGETPROGRAMBINARYPROC, rg_glGetProgramBinary)
+RG_GL_ENTRY_POINT(PFNGLPROGRAMBINARYPROC, rg_glProgramBinary)
+RG_GL_ENTRY_POINT(PFNGLPROGRAMPARAMETERIPROC, rg_glProgramParameteri)
+RG_GL_ENTRY_POINT(PFNGLSHADERBINARYPROC, rg_glShaderBinary)
+#define glGetProgramBinary rg_glGetProgramBinary()
+#define glProgramBinary rg_glProgramBinary()
+#define glProgramParameteri rg_glProgramParameteri()
+#define glShaderBinary rg_glShaderBinary()
+#endif
+
+#ifndef GL_VERSION_4_3
+typedef void (APIENTRYP PFNGLVERTEXATTRIBFORMATPROC)(GLuint attribindex, GLint size, GLenum type, GLboolean normalized, GLuint relativeoffset);
+typedef void (APIENTRYP PFNGLVERTEXATTRIBIFORMATPROC)(GLuint attribindex, GLint size, GLenum type, GLuint relativeoffset);
+typedef void (APIENTRYP PFNGLVERTEXATTRIBBINDINGPROC)(GLuint attribindex, GLuint bindingindex);
+typedef void (APIENTRYP PFNGLBINDVERTEXBUFFERPROC)(GLuint bindingindex, GLuint buffer, GLintptr offset, GLsizei stride);
+typedef void (APIENTRYP PFNGLVERTEXBINDINGDIVISORPROC)(GLuint bindingindex, GLuint divisor);
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
+RG_GL_ENTRY_POINT(PFNGLVERTEXATTRIBFORMATPROC, rg_glVertexAttribFormat)
+RG_GL_ENTRY_POINT(PFNGLVERTEXATTRIBIFORMATPROC, rg_glVertexAttribIFormat)
+RG_GL_ENTRY_POINT(PFNGLVERTEXATTRIBBINDINGPROC, rg_glVertexAttribBinding)
+RG_GL_ENTRY_POINT(PFNGLBINDVERTEXBUFFERPROC, rg_glBindVertexBuffer)
+RG_GL_ENTRY_POINT(PFNGLVERTEXBINDINGDIVISORPROC, rg_glVertexBindingDivisor)
+RG_GL_ENTRY_POINT(PFNGLMULTIDRAWELEMENTSINDIRECTPROC, rg_glMultiDrawElementsIndirect)
+#define glVertexAttribFormat rg_glVertexAttribFormat()
+#define glVertexAttribIFormat rg_glVertexAttribIFormat()
+#define glVertexAttribBinding rg_glVertexAttribBinding()
+#define glBindVertexBuffer rg_glBindVertexBuffer()
+#define glVertexBindingDivisor rg_glVertexBindingDivisor()
+#define glMultiDrawElementsIndirect rg_glMultiDrawElementsIndirect()
+#define GL_COMPUTE_SHADER 0x91B9
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#define GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT 0x90DF
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+typedef void (APIENTRYP PFNGLDISPATCHCOMPUTEPROC)(GLuint num_groups_x, GLuint num_groups_y, GLuint num_groups_z);
+typedef void (APIENTRYP PFNGLMEMORYBARRIERPROC)(GLbitfield barriers);
+typedef void (APIENTRYP PFNGLCLEARBUFFERDATAPROC)(GLenum target, GLenum internalformat, GLenum format, GLenum type, const void *data);
+RG_GL_ENTRY_POINT(PFNGLDISPATCHCOMPUTEPROC, rg_glDispatchCompute)
+RG_GL_ENTRY_POINT(PFNGLMEMORYBARRIERPROC, rg_glMemoryBarrier)
+RG_GL_ENTRY_POINT(PFNGLCLEARBUFFERDATAPROC, rg_glClearBufferData)
+#define glDispatchCompute rg_glDispatchCompute()
+#define glMemoryBarrier rg_glMemoryBarrier()
+#define glClearBufferData rg_glClearBufferData()
+#endif
+
+#ifndef GL_VERSION_4_4
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+RG_GL_ENTRY_POINT(PFNGLBUFFERSTORAGEPROC, rg_glBufferStorage)
+#define glBufferStorage rg_glBufferStorage()
+#endif
+
+#ifndef GL_VERSION_4_6
+#define GL_SHADER_BINARY_FORMAT_SPIR_V 0x9551
+#define GL_SPIR_V_BINARY 0x9552
+typedef void (APIENTRYP PFNGLSPECIALIZESHADERPROC)(GLuint shader, const GLchar *pEntryPoint, GLuint numSpecializationConstants, const GLuint *pConstantIndex, const GLuint *pConstantValue);
+RG_GL_ENTRY_POINT(PFNGLSPECIALIZESHADERPROC, rg_glSpecializeShader)
+#define glSpecializeShader rg_glSpecializeShader()
+#endif
+
+#ifndef GL_ARB_indirect_parameters
+#define GL_PARAMETER_BUFFER_ARB 0x80EE
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTARBPROC)(GLenum mode, GLenum type, const void *indirect, GLintptr drawcount, GLsizei maxdrawcount, GLsizei stride);
+RG_GL_ENTRY_POINT(PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTARBPROC, rg_glMultiDrawElementsIndirectCountARB)
+#define glMultiDrawElementsIndirectCountARB rg_glMultiDrawElementsIndirectCountARB()
+#endif
+
+#ifndef GL_KHR_debug
+#define GL_DEBUG_OUTPUT_SYNCHRONOUS 0x8242
+#define GL_DEBUG_SOURCE_API 0x8246
+#define GL_DEBUG_SOURCE_WINDOW_SYSTEM 0x8247
+#define GL_DEBUG_SOURCE_SHADER_COMPILER 0x8248
+#define GL_DEBUG_SOURCE_THIRD_PARTY 0x8249
+#define GL_DEBUG_SOURCE_APPLICATION 0x824A
+#define GL_DEBUG_SOURCE_OTHER 0x824B
+#define GL_DEBUG_TYPE_ERROR 0x824C
+#define GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR 0x824D
+#define GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR 0x824E
+#define GL_DEBUG_TYPE_PORTABILITY 0x824F
+#define GL_DEBUG_TYPE_PERFORMANCE 0x8250
+#define GL_DEBUG_TYPE_OTHER 0x8251
+#define GL_DEBUG_TYPE_MARKER 0x8268
+#define GL_DEBUG_TYPE_PUSH_GROUP 0x8269
+#define GL_DEBUG_TYPE_POP_GROUP 0x826A
+#define GL_DEBUG_SEVERITY_NOTIFICATION 0x826B
+#define GL_DEBUG_SEVERITY_HIGH 0x9146
+#define GL_DEBUG_SEVERITY_MEDIUM 0x9147
+#define GL_DEBUG_SEVERITY_LOW 0x9148
+#define GL_DEBUG_OUTPUT 0x92E0
+#define GL_CONTEXT_FLAG_DEBUG_BIT 0x00000002
+typedef void (APIENTRYP PFNGLDEBUGMESSAGECONTROLPROC)(GLenum source, GLenum type, GLenum severity, GLsizei count, const GLuint *ids, GLboolean enabled);
+typedef void (APIENTRYP PFNGLDEBUGMESSAGECALLBACKPROC)(GLDEBUGPROC callback, const void *userParam);
+typedef void (APIENTRYP PFNGLPUSHDEBUGGROUPPROC)(GLenum source, GLuint id, GLsizei length, const GLchar *message);
+typedef void (APIENTRYP PFNGLPOPDEBUGGROUPPROC)(void);
+RG_GL_ENTRY_POINT(PFNGLDEBUGMESSAGECONTROLPROC, rg_glDebugMessageControl)
+RG_GL_ENTRY_POINT(PFNGLDEBUGMESSAGECALLBACKPROC, rg_glDebugMessageCallback)
+RG_GL_ENTRY_POINT(PFNGLPUSHDEBUGGROUPPROC, rg_glPushDebugGroup)
+RG_GL_ENTRY_POINT(PFNGLPOPDEBUGGROUPPROC, rg_glPopDebugGroup)
+#define glDebugMessageControl rg_glDebugMessageControl()
+#define glDebugMessageCallback rg_glDebugMessageCallback()
+#define glPushDebugGroup rg_glPushDebugGroup()
+#define glPopDebugGroup rg_glPopDebugGroup()
+#endif
+
+#ifndef GL_KHR_parallel_shader_compile
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+RG_GL_ENTRY_POINT(PFNGLMAXSHADERCOMPILERTHREADSKHRPROC, rg_glMaxShaderCompilerThreadsKHR)
+#define glMaxShaderCompilerThreadsKHR rg_glMaxShaderCompilerThreadsKHR()
+#endif
+
+namespace rg {
+
+// Version, driver strings and extensions of the current context.
+struct GlInfo {
+    int major = 0;
+    int minor = 0;
+    std::string vendor;
+    std::string renderer;
+    std::string version;
+    std::set<std::string> extensions;
+    // GL_COMPLETION_STATUS_KHR can be polled and compiles run on driver threads
+    bool parallelShaderCompile = false;
+    // vertex formats are set apart from the buffers (glVertexAttribFormat/glBindVertexBuffer)
+    bool vertexAttribBinding = false;
+    // glMultiDrawElementsIndirect with baseInstance (4.3, or the ARB extensions on 4.2)
+    bool multiDrawIndirect = false;
+    // GL_KHR_debug message callback and debug groups
+    bool debugOutput = false;
+    // compute shaders with shader storage buffers (4.3)
+    bool computeShader = false;
+    // the draw count of a multi-draw is read from a buffer (GL_ARB_indirect_parameters)
+    bool indirectCount = false;
+    // immutable buffers that stay mapped while the GPU reads them (4.4, GL_ARB_buffer_storage)
+    bool bufferStorage = false;
+    // SPIR-V modules through glShaderBinary and glSpecializeShader (4.6, GL_ARB_gl_spirv)
+    bool spirv = false;
+    // offsets of glBindBufferRange have to be multiples of these
+    GLint uniformBufferAlignment = 256;
+    GLint shaderStorageAlignment = 256;
+
+    bool atLeast(int requiredMajor, int requiredMinor) const {
+        return major > requiredMajor || (major == requiredMajor && minor >= requiredMinor);
+    }
+    bool has(const char* extension) const { return extensions.count(extension) != 0; }
+};
+
+inline GlInfo& glInfo() {
+    static GlInfo info;
+    return info;
+}
+
+inline void loadGlExtensions(GLADloadproc load) {
+    GlInfo& info = glInfo();
+    glGetIntegerv(GL_MAJOR_VERSION, &info.major);
+    glGetIntegerv(GL_MINOR_VERSION, &info.minor);
+    info.vendor = (const char*)glGetString(GL_VENDOR);
+    info.renderer = (const char*)glGetString(GL_RENDERER);
+    info.version = (const char*)glGetString(GL_VERSION);
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i)
+        info.extensions.insert((const char*)glGetStringi(GL_EXTENSIONS, i));
+
+#ifndef GL_VERSION_4_1
+    rg_glGetProgramBinary() = (PFNGLGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+    rg_glProgramBinary() = (PFNGLPROGRAMBINARYPROC)load("glProgramBinary");
+    rg_glProgramParameteri() = (PFNGLPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+    rg_glShaderBinary() = (PFNGLSHADERBINARYPROC)load("glShaderBinary");
+#endif
+#ifndef GL_VERSION_4_3
+    // same entry point names in GL_ARB_vertex_attrib_binding
+    if (info.atLeast(4, 3) || info.has("GL_ARB_vertex_attrib_binding")) {
+        rg_glVertexAttribFormat() = (PFNGLVERTEXATTRIBFORMATPROC)load("glVertexAttribFormat");
+        rg_glVertexAttribIFormat() = (PFNGLVERTEXATTRIBIFORMATPROC)load("glVertexAttribIFormat");
+        rg_glVertexAttribBinding() = (PFNGLVERTEXATTRIBBINDINGPROC)load("glVertexAttribBinding");
+        rg_glBindVertexBuffer() = (PFNGLBINDVERTEXBUFFERPROC)load("glBindVertexBuffer");
+        rg_glVertexBindingDivisor() = (PFNGLVERTEXBINDINGDIVISORPROC)load("glVertexBindingDivisor");
+    }
+    // baseInstance in indirect commands needs 4.2 / ARB_base_instance
+    if (info.atLeast(4, 3) || (info.has("GL_ARB_multi_draw_indirect") && info.atLeast(4, 2)))
+        rg_glMultiDrawElementsIndirect() = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)load("glMultiDrawElementsIndirect");
+    // the compute shaders are #version 430, the ARB extensions on older contexts aren't enough
+    if (info.atLeast(4, 3)) {
+        rg_glDispatchCompute() = (PFNGLDISPATCHCOMPUTEPROC)load("glDispatchCompute");
+        rg_glMemoryBarrier() = (PFNGLMEMORYBARRIERPROC)load("glMemoryBarrier");
+        rg_glClearBufferData() = (PFNGLCLEARBUFFERDATAPROC)load("glClearBufferData");
+    }
+#endif
+#ifndef GL_VERSION_4_4
+    if (info.atLeast(4, 4) || info.has("GL_ARB_buffer_storage"))
+        rg_glBufferStorage() = (PFNGLBUFFERSTORAGEPROC)load("glBufferStorage");
+#endif
+#ifndef GL_VERSION_4_6
+    if (info.atLeast(4, 6))
+        rg_glSpecializeShader() = (PFNGLSPECIALIZESHADERPROC)load("glSpecializeShader");
+    else if (info.has("GL_ARB_gl_spirv"))
+        rg_glSpecializeShader() = (PFNGLSPECIALIZESHADERPROC)load("glSpecializeShaderARB");
+#endif
+#ifndef GL_ARB_indirect_parameters
+    if (info.has("GL_ARB_indirect_parameters"))
+        rg_glMultiDrawElementsIndirectCountARB() =
+                (PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTARBPROC)load("glMultiDrawElementsIndirectCountARB");
+#endif
+#ifndef GL_KHR_debug
+    // core in 4.3, desktop GL_KHR_debug uses the same unsuffixed names
+    if (info.atLeast(4, 3) || info.has("GL_KHR_debug")) {
+        rg_glDebugMessageControl() = (PFNGLDEBUGMESSAGECONTROLPROC)load("glDebugMessageControl");
+        rg_glDebugMessageCallback() = (PFNGLDEBUGMESSAGECALLBACKPROC)load("glDebugMessageCallback");
+        rg_glPushDebugGroup() = (PFNGLPUSHDEBUGGROUPPROC)load("glPushDebugGroup");
+        rg_glPopDebugGroup() = (PFNGLPOPDEBUGGROUPPROC)load("glPopDebugGroup");
+    }
+#endif
+#ifndef GL_KHR_parallel_shader_compile
+    // the ARB variant shares the enums, only the entry point name differs
+    if (info.has("GL_KHR_parallel_shader_compile"))
+        rg_glMaxShaderCompilerThreadsKHR() = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsKHR");
+    else if (info.has("GL_ARB_parallel_shader_compile"))
+        rg_glMaxShaderCompilerThreadsKHR() = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsARB");
+#endif
+    info.parallelShaderCompile = glMaxShaderCompilerThreadsKHR != nullptr;
+    info.vertexAttribBinding = glVertexAttribFormat != nullptr && glVertexAttribIFormat != nullptr &&
+                               glVertexAttribBinding != nullptr && glBindVertexBuffer != nullptr &&
+                               glVertexBindingDivisor != nullptr;
+    info.multiDrawIndirect = glMultiDrawElementsIndirect != nullptr;
+    info.debugOutput = glDebugMessageControl != nullptr && glDebugMessageCallback != nullptr &&
+                       glPushDebugGroup != nullptr && glPopDebugGroup != nullptr;
+    info.computeShader = glDispatchCompute != nullptr && glMemoryBarrier != nullptr && glClearBufferData != nullptr;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &info.uniformBufferAlignment);
+    if (info.computeShader)
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &info.shaderStorageAlignment);
+    info.indirectCount = glMultiDrawElementsIndirectCountARB != nullptr;
+    info.bufferStorage = glBufferStorage != nullptr;
+    info.spirv = glShaderBinary != nullptr && glSpecializeShader != nullptr;
+}
+
+};
+
+#endif //PROJECT_BASE_GLEXTENSIONS_H
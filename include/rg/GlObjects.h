@@ -0,0 +1,87 @@
+#ifndef PROJECT_BASE_GLOBJECTS_H
+#define PROJECT_BASE_GLOBJECTS_H
+
+#include <glad/glad.h>
+#include <rg/RenderStats.h>
+
+#include <utility>
+
+namespace rg {
+
+// Move-only owner of one GL object name, deleted with the owner. Owners have to go away while
+// the context is still current.
+template <typename Traits>
+class GlObject {
+public:
+    GlObject() = default;
+    // takes ownership of a name created elsewhere
+    explicit GlObject(GLuint id) : id(id) {}
+    ~GlObject() { reset(); }
+
+    GlObject(GlObject&& other) noexcept : id(other.release()) {}
+    GlObject& operator=(GlObject&& other) noexcept {
+        if (this != &other)
+            reset(other.release());
+        return *this;
+    }
+    GlObject(const GlObject&) = delete;
+    GlObject& operator=(const GlObject&) = delete;
+
+    static GlObject create() {
+        GLuint id = 0;
+        Traits::create(id);
+        return GlObject(id);
+    }
+
+    GLuint get() const { return id; }
+    explicit operator bool() const { return id != 0; }
+
+    GLuint release() {
+        GLuint released = id;
+        id = 0;
+        return released;
+    }
+
+    void reset(GLuint replacement = 0) {
+        if (id != 0)
+            Traits::destroy(id);
+        id = replacement;
+    }
+
+private:
+    GLuint id = 0;
+};
+
+struct GlBufferTraits {
+    static void create(GLuint& id) { glGenBuffers(1, &id); }
+    static void destroy(GLuint id) { glDeleteBuffers(1, &id); }
+};
+
+struct GlVertexArrayTraits {
+    static void create(GLuint& id) { glGenVertexArrays(1, &id); }
+    static void destroy(GLuint id) {
+        // deleting the bound vertex array binds 0
+        if (gl::boundVertexArray() == id)
+            gl::boundVertexArray() = 0;
+        glDeleteVertexArrays(1, &id);
+    }
+};
+
+struct GlTextureTraits {
+    static void create(GLuint& id) { glGenTextures(1, &id); }
+    static void destroy(GLuint id) { glDeleteTextures(1, &id); }
+};
+
+struct GlFramebufferTraits {
+    static void create(GLuint& id) { glGenFramebuffers(1, &id); }
+    static void destroy(GLuint id) { glDeleteFramebuffers(1, &id); }
+};
+
+using GlBuffer = GlObject<GlBufferTraits>;
+using GlVertexArray = GlObject<GlVertexArrayTraits>;
+using GlTexture = GlObject<GlTextureTraits>;
+using GlFramebuffer = GlObject<GlFramebufferTraits>;
+
+};
+
+#endif //PROJECT_BASE_GLOBJECTS_H
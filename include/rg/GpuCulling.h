@@ -0,0 +1,175 @@
+#ifndef PROJECT_BASE_GPUCULLING_H
+#define PROJECT_BASE_GPUCULLING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader.h>
+#include <rg/Culling.h>
+#include <rg/GlExtensions.h>
+#include <rg/GlObjects.h>
+#include <rg/HiZPyramid.h>
+#include <rg/MultiDraw.h>
+#include <rg/RenderStats.h>
+#include <rg/ShaderLibrary.h>
+#include <rg/StreamBuffer.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace rg {
+
+// per draw input of cull.cs (std430)
+struct CullBounds {
+    glm::vec4 sphere;
+    glm::vec4 cone;
+    uint32_t group;
+    // first command of the group, where its survivors are written
+    uint32_t groupFirst;
+    uint32_t padding[2];
+};
+static_assert(sizeof(CullBounds) == 48, "CullBounds has to match the std430 layout in cull.cs");
+
+// Culls the draws of an IndirectDrawList in a compute shader (cull.cs): every draw's sphere is
+// tested against the frustum, its normal cone against the camera position and, in CullMode::HiZ,
+// the sphere against the previous frame's Hi-Z pyramid. The survivors of a group are packed to
+// the front of the group's range of a second command buffer and counted per group. With
+// GL_ARB_indirect_parameters the count is the draw count of the group's multi-draw, otherwise
+// the rest of the range stays zeroed and draws nothing.
+//
+// Without compute shaders (or multi-draw) cpuFrustum() and cpuEye() give IndirectDrawList::build()
+// the same tests, so the 3.3 path still skips what is off screen or facing away.
+class GpuCulling {
+public:
+    CullMode mode = CullMode::Frustum;
+
+    void init(ShaderLibrary& library) {
+        if (!glInfo().computeShader || !glInfo().multiDrawIndirect)
+            return;
+        program = &library.addCompute("resources/shaders/cull.cs");
+        library.setInitializer(*program, [](Shader& shader) {
+            shader.use();
+            shader.setInt("hiZDepth", 0);
+        });
+        visible = GlBuffer::create();
+        counts = GlBuffer::create();
+    }
+
+    // camera of the frame, hiZ is used in CullMode::HiZ once it has been built
+    void beginFrame(const glm::mat4& viewProjection, const glm::vec3& cameraPosition, const HiZPyramid* hiZ) {
+        frustum = Frustum(viewProjection);
+        eye = cameraPosition;
+        pyramid = hiZ;
+        dispatched = false;
+    }
+
+    // compute culling is supported by the context
+    bool available() const { return program != nullptr; }
+    bool onGpu() const { return program != nullptr && mode != CullMode::Off; }
+    bool wantsHiZ() const { return onGpu() && mode == CullMode::HiZ; }
+    const Frustum* cpuFrustum() const { return mode != CullMode::Off && !onGpu() ? &frustum : nullptr; }
+    const glm::vec3* cpuEye() const { return mode != CullMode::Off && !onGpu() ? &eye : nullptr; }
+
+    // after list.build() and list.upload(ring), the bounds go to the same ring
+    template <typename Instance>
+    void dispatch(const IndirectDrawList<Instance>& list, StreamBuffer& ring) {
+        dispatched = false;
+        const std::vector<glm::vec4>& spheres = list.boundsData();
+        const std::vector<glm::vec4>& cones = list.coneData();
+        if (!onGpu() || spheres.empty())
+            return;
+        const auto& groups = list.groups();
+        records.resize(spheres.size());
+        for (uint32_t g = 0; g < (uint32_t)groups.size(); ++g) {
+            for (uint32_t i = groups[g].firstCommand; i < groups[g].firstCommand + groups[g].commandCount; ++i)
+                records[i] = CullBounds{spheres[i], cones[i], g, groups[g].firstCommand, {0, 0}};
+        }
+
+        GLintptr boundsOffset = ring.write(records.data(), records.size(), (size_t)glInfo().shaderStorageAlignment);
+        ring.flush();
+
+        // the outputs are written by the GPU only, they grow by doubling and start zeroed every
+        // frame; the clears are ordered after the previous frame's draws on the GPU
+        if (records.size() > capacity) {
+            capacity = std::max(records.size(), capacity * 2);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, visible.get());
+            gl::BufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_COPY);
+        }
+        if (groups.size() > groupCapacity) {
+            groupCapacity = std::max(groups.size(), groupCapacity * 2);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, counts.get());
+            gl::BufferData(GL_SHADER_STORAGE_BUFFER, groupCapacity * sizeof(uint32_t), nullptr, GL_DYNAMIC_COPY);
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, visible.get());
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, counts.get());
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, ring.buffer(), boundsOffset,
+                          (GLsizeiptr)(records.size() * sizeof(CullBounds)));
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 1, list.commandBuffer(), list.commandOffset(),
+                          (GLsizeiptr)(records.size() * sizeof(DrawElementsIndirectCommand)));
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, visible.get());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, counts.get());
+
+        program->use();
+        program->setInt("drawCount", (int)records.size());
+        gl::Uniform4fv(glGetUniformLocation(program->ID, "planes"), 6, &frustum.planes[0][0]);
+        program->setVec3("cameraPosition", eye);
+        bool hiZ = mode == CullMode::HiZ && pyramid && pyramid->valid();
+        program->setBool("useHiZ", hiZ);
+        if (hiZ) {
+            program->setMat4("hiZViewProjection", pyramid->viewProjection());
+            program->setVec2("hiZSize", glm::vec2(pyramid->size()));
+            program->setInt("hiZLevels", pyramid->levelCount());
+            glActiveTexture(GL_TEXTURE0);
+            gl::BindTexture(GL_TEXTURE_2D, pyramid->texture());
+        }
+        glDispatchCompute(((GLuint)records.size() + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+        // the commands and counts are read by the draws
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+        dispatched = true;
+    }
+
+    // true when this frame's draws have to come from submit()
+    bool culled() const { return dispatched; }
+
+    // The survivors of the group, in place of list.submit(group). The triangle count of the
+    // stats is the group's before culling, the GPU's result isn't read back.
+    template <typename Instance>
+    void submit(const IndirectDrawList<Instance>& list, uint32_t groupIndex, GLenum mode = GL_TRIANGLES) const {
+        const typename IndirectDrawList<Instance>::Group& group = list.groups()[groupIndex];
+        FrameStats& stats = RenderStats::current();
+        ++stats.drawCalls;
+        for (uint32_t i = 0; i < group.commandCount; ++i)
+            stats.triangles += gl::primitiveTriangles(mode, list.commandData()[group.firstCommand + i].count);
+        const void* offset = (const void*)((size_t)group.firstCommand * sizeof(DrawElementsIndirectCommand));
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, visible.get());
+        if (glInfo().indirectCount) {
+            glBindBuffer(GL_PARAMETER_BUFFER_ARB, counts.get());
+            glMultiDrawElementsIndirectCountARB(mode, GL_UNSIGNED_INT, offset, (GLintptr)groupIndex * sizeof(uint32_t),
+                                                (GLsizei)group.commandCount, 0);
+        } else {
+            glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, offset, (GLsizei)group.commandCount, 0);
+        }
+    }
+
+private:
+    // local_size_x of cull.cs
+    static const GLuint GROUP_SIZE = 64;
+
+    Shader* program = nullptr;
+    Frustum frustum;
+    glm::vec3 eye = glm::vec3(0.0f);
+    const HiZPyramid* pyramid = nullptr;
+    std::vector<CullBounds> records;
+    GlBuffer visible;
+    GlBuffer counts;
+    size_t capacity = 0;
+    size_t groupCapacity = 0;
+    bool dispatched = false;
+};
+
+};
+
+#endif //PROJECT_BASE_GPUCULLING_H
@@ -0,0 +1,143 @@
+#ifndef PROJECT_BASE_GPUTIMER_H
+#define PROJECT_BASE_GPUTIMER_H
+
+#include <glad/glad.h>
+#include <rg/DebugOutput.h>
+
+#include <cstring>
+
+namespace rg {
+
+// Results are read back GPU_TIMER_FRAMES frames after they were issued, by then the GPU is
+// done with them and glGetQueryObject never waits.
+const unsigned int GPU_TIMER_FRAMES = 3;
+const unsigned int GPU_TIMER_MAX_PASSES = 16;
+const unsigned int GPU_TIMER_HISTORY = 120;
+
+// Measures GPU time of render passes with GL_TIMESTAMP query pairs. Timestamps (unlike
+// GL_TIME_ELAPSED) can be nested, so a pass may contain other passes. Pass 0 is the whole frame.
+class GpuProfiler {
+public:
+    void init() {
+        glGenQueries(GPU_TIMER_FRAMES * GPU_TIMER_MAX_PASSES * 2, &queries[0][0][0]);
+        names[0] = "Frame";
+        passes = 1;
+        initialized = true;
+    }
+
+    void destroy() {
+        if (!initialized)
+            return;
+        glDeleteQueries(GPU_TIMER_FRAMES * GPU_TIMER_MAX_PASSES * 2, &queries[0][0][0]);
+        initialized = false;
+    }
+
+    void beginFrame() {
+        if (!initialized)
+            return;
+        slot = (slot + 1) % GPU_TIMER_FRAMES;
+        collect(slot);
+        std::memset(issued[slot], 0, sizeof(issued[slot]));
+        glQueryCounter(queries[slot][0][0], GL_TIMESTAMP);
+    }
+
+    void endFrame() {
+        if (!initialized)
+            return;
+        glQueryCounter(queries[slot][0][1], GL_TIMESTAMP);
+        issued[slot][0] = true;
+    }
+
+    // name has to outlive the profiler, string literals are expected
+    unsigned int begin(const char* name) {
+        unsigned int pass = find(name);
+        if (initialized && pass < GPU_TIMER_MAX_PASSES)
+            glQueryCounter(queries[slot][pass][0], GL_TIMESTAMP);
+        return pass;
+    }
+
+    void end(unsigned int pass) {
+        if (!initialized || pass >= GPU_TIMER_MAX_PASSES)
+            return;
+        glQueryCounter(queries[slot][pass][1], GL_TIMESTAMP);
+        issued[slot][pass] = true;
+    }
+
+    unsigned int passCount() const { return passes; }
+    const char* passName(unsigned int pass) const { return names[pass]; }
+    float lastMs(unsigned int pass) const { return history[pass][(historyOffset + GPU_TIMER_HISTORY - 1) % GPU_TIMER_HISTORY]; }
+    const float* historyMs(unsigned int pass) const { return history[pass]; }
+    // index of the oldest history entry, for ImGui::PlotLines
+    unsigned int historyStart() const { return historyOffset; }
+
+    // averages since the last resetAverages(), used by benchmark sweeps
+    void resetAverages() {
+        std::memset(sumMs, 0, sizeof(sumMs));
+        std::memset(samples, 0, sizeof(samples));
+    }
+    double averageMs(unsigned int pass) const { return samples[pass] ? sumMs[pass] / samples[pass] : 0.0; }
+
+private:
+    GLuint queries[GPU_TIMER_FRAMES][GPU_TIMER_MAX_PASSES][2] = {};
+    bool issued[GPU_TIMER_FRAMES][GPU_TIMER_MAX_PASSES] = {};
+    const char* names[GPU_TIMER_MAX_PASSES] = {};
+    float history[GPU_TIMER_MAX_PASSES][GPU_TIMER_HISTORY] = {};
+    double sumMs[GPU_TIMER_MAX_PASSES] = {};
+    unsigned int samples[GPU_TIMER_MAX_PASSES] = {};
+    unsigned int passes = 0;
+    unsigned int slot = 0;
+    unsigned int historyOffset = 0;
+    bool initialized = false;
+
+    unsigned int find(const char* name) {
+        for (unsigned int i = 0; i < passes; ++i) {
+            if (names[i] == name || std::strcmp(names[i], name) == 0)
+                return i;
+        }
+        if (passes == GPU_TIMER_MAX_PASSES)
+            return GPU_TIMER_MAX_PASSES;
+        names[passes] = name;
+        return passes++;
+    }
+
+    void collect(unsigned int frame) {
+        if (!issued[frame][0])
+            return;
+        for (unsigned int pass = 0; pass < passes; ++pass) {
+            float ms = 0.0f;
+            GLint available = 0;
+            if (issued[frame][pass])
+                glGetQueryObjectiv(queries[frame][pass][1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint64 start = 0, end = 0;
+                glGetQueryObjectui64v(queries[frame][pass][0], GL_QUERY_RESULT, &start);
+                glGetQueryObjectui64v(queries[frame][pass][1], GL_QUERY_RESULT, &end);
+                ms = (float)((end - start) / 1.0e6);
+                sumMs[pass] += ms;
+                ++samples[pass];
+            }
+            history[pass][historyOffset] = ms;
+        }
+        historyOffset = (historyOffset + 1) % GPU_TIMER_HISTORY;
+    }
+};
+
+// Times everything issued between construction and destruction as one pass, which is also a
+// debug group so GL messages and frame captures show the same passes.
+class GpuScope {
+public:
+    GpuScope(GpuProfiler& profiler, const char* name)
+    : group(name), profiler(profiler), pass(profiler.begin(name)) {}
+    ~GpuScope() { profiler.end(pass); }
+
+    GpuScope(const GpuScope&) = delete;
+    GpuScope& operator=(const GpuScope&) = delete;
+private:
+    DebugGroup group;
+    GpuProfiler& profiler;
+    unsigned int pass;
+};
+
+};
+
+#endif //PROJECT_BASE_GPUTIMER_H
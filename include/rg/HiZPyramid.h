@@ -0,0 +1,121 @@
+#ifndef PROJECT_BASE_HIZPYRAMID_H
+#define PROJECT_BASE_HIZPYRAMID_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader.h>
+#include <rg/GlObjects.h>
+#include <rg/RenderStats.h>
+#include <rg/ShaderLibrary.h>
+
+#include <algorithm>
+
+namespace rg {
+
+// Mip chain of the depth buffer where every texel holds the farthest depth of the texels it
+// covers, so one texel of a coarse level tells whether anything behind it is hidden. Built from
+// the depth of the default framebuffer after the opaque passes and tested against by the next
+// frame's culling, with the view projection it was rendered with.
+class HiZPyramid {
+public:
+    void init(ShaderLibrary& library) {
+        program = &library.add("resources/shaders/hiz.vs", "resources/shaders/hiz.fs");
+        library.setInitializer(*program, [](Shader& shader) {
+            shader.use();
+            shader.setInt("previousLevel", 0);
+        });
+        framebuffer = GlFramebuffer::create();
+        // the full screen triangle is made in the vertex shader, core profile still wants a VAO
+        emptyVertexArray = GlVertexArray::create();
+    }
+
+    // Copies level 0 from the depth buffer and reduces it level by level. Leaves the default
+    // framebuffer bound with a viewport of width x height.
+    void build(int width, int height, const glm::mat4& viewProjection) {
+        if (width <= 0 || height <= 0 || !program)
+            return;
+        if (width != levelSize.x || height != levelSize.y)
+            allocate(width, height);
+
+        glActiveTexture(GL_TEXTURE0);
+        gl::BindTexture(GL_TEXTURE_2D, depth.get());
+        // a depth format texture copies from the read framebuffer's depth buffer
+        glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+
+        program->use();
+        gl::BindVertexArray(emptyVertexArray.get());
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.get());
+        glDepthFunc(GL_ALWAYS);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glm::ivec2 size = levelSize;
+        for (int level = 1; level < levels; ++level) {
+            size = glm::max(size / 2, glm::ivec2(1));
+            // the level that is read is the only one the shader sees, the written one can't feed back
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth.get(), level);
+            glViewport(0, 0, size.x, size.y);
+            gl::DrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthFunc(GL_LESS);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, width, height);
+        builtViewProjection = viewProjection;
+        built = true;
+    }
+
+    // a frame that skips the build leaves the pyramid stale, the next frame must not test against it
+    void invalidate() { built = false; }
+
+    // false until the first build, after a resize and after a frame without a build
+    bool valid() const { return built; }
+    GLuint texture() const { return depth.get(); }
+    int levelCount() const { return levels; }
+    glm::ivec2 size() const { return levelSize; }
+    const glm::mat4& viewProjection() const { return builtViewProjection; }
+
+private:
+    Shader* program = nullptr;
+    GlTexture depth;
+    GlFramebuffer framebuffer;
+    GlVertexArray emptyVertexArray;
+    glm::ivec2 levelSize = glm::ivec2(0);
+    int levels = 0;
+    glm::mat4 builtViewProjection = glm::mat4(1.0f);
+    bool built = false;
+
+    void allocate(int width, int height) {
+        levelSize = glm::ivec2(width, height);
+        levels = 1;
+        while ((std::max(width, height) >> levels) > 0)
+            ++levels;
+        depth = GlTexture::create();
+        glActiveTexture(GL_TEXTURE0);
+        gl::BindTexture(GL_TEXTURE_2D, depth.get());
+        glm::ivec2 size = levelSize;
+        for (int level = 0; level < levels; ++level) {
+            glTexImage2D(GL_TEXTURE_2D, level, GL_DEPTH_COMPONENT32F, size.x, size.y, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+            size = glm::max(size / 2, glm::ivec2(1));
+        }
+        // read with texelFetch, depth values and not comparison results
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.get());
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        built = false;
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_HIZPYRAMID_H
@@ -0,0 +1,79 @@
+#ifndef PROJECT_BASE_LINEARALLOCATOR_H
+#define PROJECT_BASE_LINEARALLOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+namespace rg {
+
+// Bump allocator for data that only lives for one frame. The backing block is allocated once,
+// reset() releases everything at the start of the next frame. Requests that don't fit go to
+// malloc and are counted in overflowBytes(), so a too small arena shows up instead of crashing.
+class LinearAllocator {
+public:
+    explicit LinearAllocator(size_t capacity)
+    : buffer((unsigned char*)std::malloc(capacity)), capacity(capacity) {}
+
+    ~LinearAllocator() {
+        reset();
+        std::free(buffer);
+    }
+
+    LinearAllocator(const LinearAllocator&) = delete;
+    LinearAllocator& operator=(const LinearAllocator&) = delete;
+
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+        size_t start = (offset + alignment - 1) & ~(alignment - 1);
+        if (start + size <= capacity) {
+            offset = start + size;
+            if (offset > highWater)
+                highWater = offset;
+            return buffer + start;
+        }
+        // overflow blocks are chained through a header in front of the returned memory
+        size_t header = (sizeof(void*) + alignment - 1) & ~(alignment - 1);
+        unsigned char* block = (unsigned char*)std::malloc(header + size);
+        if (!block)
+            return nullptr;
+        *(void**)block = overflow;
+        overflow = block;
+        overflowed += size;
+        return block + header;
+    }
+
+    template <typename T>
+    T* allocateArray(size_t count) {
+        return (T*)allocate(sizeof(T) * count, alignof(T));
+    }
+
+    void reset() {
+        while (overflow) {
+            void* next = *(void**)overflow;
+            std::free(overflow);
+            overflow = next;
+        }
+        lastOverflow = overflowed;
+        overflowed = 0;
+        offset = 0;
+    }
+
+    size_t used() const { return offset; }
+    size_t size() const { return capacity; }
+    size_t highWaterMark() const { return highWater; }
+    // bytes that did not fit into the arena during the previous frame
+    size_t overflowBytes() const { return lastOverflow; }
+
+private:
+    unsigned char* buffer;
+    size_t capacity;
+    size_t offset = 0;
+    size_t highWater = 0;
+    void* overflow = nullptr;
+    size_t overflowed = 0;
+    size_t lastOverflow = 0;
+};
+
+};
+
+#endif //PROJECT_BASE_LINEARALLOCATOR_H
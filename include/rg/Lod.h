@@ -0,0 +1,70 @@
+#ifndef PROJECT_BASE_LOD_H
+#define PROJECT_BASE_LOD_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+
+namespace rg {
+
+// select() result for objects too small to be worth drawing
+const int LOD_CULLED = -1;
+
+// levels the statistics tell apart, coarser ones are counted with the last
+const int MAX_LOD_LEVELS = 8;
+
+// Camera terms of screen-size LOD selection, refreshed every frame. A level is good enough when
+// its error (see rg::LodLevel), projected at the distance of the object, stays under
+// maxErrorPixels.
+struct LodView {
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    // pixels covered by one unit at distance one: viewport height / (2 tan(fovy / 2))
+    float pixelsPerUnit = 1.0f;
+    bool enabled = true;
+    float maxErrorPixels = 1.0f;
+    // objects with a smaller projected bounding sphere diameter are culled by contribution
+    float minSizePixels = 1.0f;
+    // width of the band around maxErrorPixels where the previous level is kept, so objects at
+    // the switching distance don't flicker between two levels
+    float hysteresis = 0.25f;
+
+    void setPerspective(const glm::vec3& position, float fovyDegrees, int viewportHeight) {
+        cameraPosition = position;
+        pixelsPerUnit = (float)viewportHeight / (2.0f * std::tan(glm::radians(fovyDegrees) * 0.5f));
+    }
+
+    // errors of the levels in model units, scale takes them to world units. Returns the coarsest
+    // level that fits (0 with the camera inside the sphere) or LOD_CULLED. previous is the level
+    // of the last frame, or LOD_CULLED if there is none.
+    int select(const float* errors, unsigned levels, const glm::vec4& sphere, float scale, int previous) const {
+        float distance = glm::distance(glm::vec3(sphere), cameraPosition) - sphere.w;
+        if (distance <= 0.0f || levels == 0)
+            return 0;
+        float pixels = pixelsPerUnit / distance;
+        if (2.0f * sphere.w * pixels < minSizePixels)
+            return LOD_CULLED;
+        if (!enabled)
+            return 0;
+        auto projected = [&](int level) { return errors[level] * scale * pixels; };
+        int lod = 0;
+        for (unsigned i = 1; i < levels; ++i) {
+            if (projected((int)i) <= maxErrorPixels)
+                lod = (int)i;
+        }
+        if (previous >= 0 && previous < (int)levels && lod != previous) {
+            // coarser only once the error is clearly under the limit, finer only once the
+            // current level is clearly over it
+            if (lod > previous) {
+                while (lod > previous && projected(lod) > maxErrorPixels * (1.0f - hysteresis))
+                    --lod;
+            } else if (projected(previous) <= maxErrorPixels * (1.0f + hysteresis)) {
+                lod = previous;
+            }
+        }
+        return lod;
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_LOD_H
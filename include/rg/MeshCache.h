@@ -0,0 +1,206 @@
+#ifndef PROJECT_BASE_MESHCACHE_H
+#define PROJECT_BASE_MESHCACHE_H
+
+#include <rg/MeshOptimizer.h>
+#include <rg/Meshlets.h>
+#include <rg/MeshSimplifier.h>
+#include <rg/Profiler.h>
+#include <rg/ShaderCache.h>
+#include <learnopengl/filesystem.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// Caches the output of the mesh optimization pass on disk: the vertices, the indices of every
+// detail level, the meshlets and the vertex cache statistics before and after. Entries are keyed by the
+// imported vertices and indices, the number of detail levels and VERSION, so a changed asset or
+// optimizer simply misses.
+//
+// Files go to <root>/cache/meshes, RG_MESH_CACHE_DIR overrides the directory and
+// RG_MESH_CACHE=0 turns the cache off.
+class MeshCache {
+public:
+    // bump when the output of the optimization pass changes
+    static const uint32_t VERSION = 2;
+
+    static bool enabled() {
+        static bool enabled = detect();
+        return enabled;
+    }
+
+    template <typename Vertex>
+    static uint64_t key(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, unsigned lodLevels) {
+        uint32_t header[3] = {VERSION, (uint32_t)sizeof(Vertex), lodLevels};
+        uint64_t hash = fnv1a(header, sizeof(header));
+        hash = fnv1a(vertices.data(), vertices.size() * sizeof(Vertex), hash);
+        return fnv1a(indices.data(), indices.size() * sizeof(uint32_t), hash);
+    }
+
+    // Replaces the arguments and returns true when there is an entry for the key.
+    template <typename Vertex>
+    static bool load(uint64_t key, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+                     std::vector<LodLevel>& lods, std::vector<Meshlet>& meshlets, VertexCacheStats& imported,
+                     VertexCacheStats& optimized) {
+        if (!enabled())
+            return false;
+        PROFILE_ZONE("MeshCache::load");
+        std::string path = entryPath(key);
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            return false;
+
+        Header header;
+        in.read((char*)&header, sizeof(header));
+        if (!in || header.magic != MAGIC || header.version != VERSION || header.key != key
+            || header.vertexSize != sizeof(Vertex) || header.lodCount == 0
+            || remainingBytes(in) != payloadSize(header)) {
+            std::remove(path.c_str());
+            return false;
+        }
+        std::vector<Vertex> cachedVertices(header.vertexCount);
+        std::vector<uint32_t> cachedIndices(header.indexCount);
+        std::vector<LodLevel> cachedLods(header.lodCount);
+        std::vector<Meshlet> cachedMeshlets(header.meshletCount);
+        VertexCacheStats stats[2];
+        in.read((char*)cachedVertices.data(), cachedVertices.size() * sizeof(Vertex));
+        in.read((char*)cachedIndices.data(), cachedIndices.size() * sizeof(uint32_t));
+        in.read((char*)cachedLods.data(), cachedLods.size() * sizeof(LodLevel));
+        in.read((char*)cachedMeshlets.data(), cachedMeshlets.size() * sizeof(Meshlet));
+        in.read((char*)stats, sizeof(stats));
+        if (!in || !validLods(cachedLods, cachedIndices) || !validIndices(cachedIndices, header.vertexCount)
+            || !validMeshlets(cachedMeshlets, cachedLods)) {
+            std::remove(path.c_str());
+            return false;
+        }
+        vertices.swap(cachedVertices);
+        indices.swap(cachedIndices);
+        lods.swap(cachedLods);
+        meshlets.swap(cachedMeshlets);
+        imported = stats[0];
+        optimized = stats[1];
+        return true;
+    }
+
+    template <typename Vertex>
+    static void store(uint64_t key, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                      const std::vector<LodLevel>& lods, const std::vector<Meshlet>& meshlets,
+                      const VertexCacheStats& imported, const VertexCacheStats& optimized) {
+        if (!enabled())
+            return;
+        PROFILE_ZONE("MeshCache::store");
+        Header header;
+        header.key = key;
+        header.vertexSize = sizeof(Vertex);
+        header.vertexCount = (uint32_t)vertices.size();
+        header.indexCount = (uint32_t)indices.size();
+        header.lodCount = (uint32_t)lods.size();
+        header.meshletCount = (uint32_t)meshlets.size();
+
+        std::string path = entryPath(key);
+        std::ofstream out(path, std::ios::binary);
+        if (!out) {
+            std::cerr << "Failed to write mesh cache entry " << path << '\n';
+            return;
+        }
+        out.write((const char*)&header, sizeof(header));
+        out.write((const char*)vertices.data(), vertices.size() * sizeof(Vertex));
+        out.write((const char*)indices.data(), indices.size() * sizeof(uint32_t));
+        out.write((const char*)lods.data(), lods.size() * sizeof(LodLevel));
+        out.write((const char*)meshlets.data(), meshlets.size() * sizeof(Meshlet));
+        out.write((const char*)&imported, sizeof(VertexCacheStats));
+        out.write((const char*)&optimized, sizeof(VertexCacheStats));
+    }
+
+private:
+    static const uint32_t MAGIC = 0x434d4752; // "RGMC"
+
+    struct Header {
+        uint32_t magic = MAGIC;
+        uint32_t version = VERSION;
+        uint64_t key = 0;
+        uint32_t vertexSize = 0;
+        uint32_t vertexCount = 0;
+        uint32_t indexCount = 0;
+        uint32_t lodCount = 0;
+        uint32_t meshletCount = 0;
+    };
+
+    // bytes after the header of an entry with the counts of header
+    static uint64_t payloadSize(const Header& header) {
+        return (uint64_t)header.vertexCount * header.vertexSize + (uint64_t)header.indexCount * sizeof(uint32_t)
+               + (uint64_t)header.lodCount * sizeof(LodLevel) + (uint64_t)header.meshletCount * sizeof(Meshlet)
+               + 2 * sizeof(VertexCacheStats);
+    }
+
+    // every level is a range of the index buffer, in the order they were appended
+    static bool validLods(const std::vector<LodLevel>& lods, const std::vector<uint32_t>& indices) {
+        uint64_t end = 0;
+        for (const LodLevel& level : lods) {
+            if (level.firstIndex < end || (uint64_t)level.firstIndex + level.indexCount > indices.size())
+                return false;
+            end = (uint64_t)level.firstIndex + level.indexCount;
+        }
+        return true;
+    }
+
+    static bool validIndices(const std::vector<uint32_t>& indices, uint32_t vertexCount) {
+        for (uint32_t index : indices) {
+            if (index >= vertexCount)
+                return false;
+        }
+        return true;
+    }
+
+    // Mesh::findLodMeshlets splits the meshlets by level: each one lies inside a level's range and
+    // they follow each other in index order
+    static bool validMeshlets(const std::vector<Meshlet>& meshlets, const std::vector<LodLevel>& lods) {
+        auto levelEnd = [&lods](size_t level) { return (uint64_t)lods[level].firstIndex + lods[level].indexCount; };
+        size_t level = 0;
+        uint64_t end = 0;
+        for (const Meshlet& meshlet : meshlets) {
+            while (level < lods.size() && meshlet.firstIndex >= levelEnd(level))
+                ++level;
+            if (level == lods.size() || meshlet.firstIndex < end || meshlet.firstIndex < lods[level].firstIndex
+                || (uint64_t)meshlet.firstIndex + meshlet.indexCount > levelEnd(level))
+                return false;
+            end = (uint64_t)meshlet.firstIndex + meshlet.indexCount;
+        }
+        return true;
+    }
+
+    static bool detect() {
+        const char* setting = std::getenv("RG_MESH_CACHE");
+        if (setting && std::string(setting) == "0")
+            return false;
+        if (!createDirectories(directory())) {
+            std::cerr << "Mesh cache disabled, cannot create " << directory() << '\n';
+            return false;
+        }
+        return true;
+    }
+
+    static const std::string& directory() {
+        static std::string dir = []() {
+            const char* env = std::getenv("RG_MESH_CACHE_DIR");
+            return env ? std::string(env) : FileSystem::getPath("cache/meshes");
+        }();
+        return dir;
+    }
+
+    static std::string entryPath(uint64_t key) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "/%016llx.mesh", (unsigned long long)key);
+        return directory() + name;
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_MESHCACHE_H
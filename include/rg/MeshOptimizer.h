@@ -0,0 +1,301 @@
+#ifndef PROJECT_BASE_MESHOPTIMIZER_H
+#define PROJECT_BASE_MESHOPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+namespace rg {
+
+// entries of the post-transform cache the orderings are tuned for, 16 to 32 on current GPUs
+const unsigned VERTEX_CACHE_SIZE = 16;
+
+// FIFO cache simulation of an index list. Adds up over meshes, so a model can report its total.
+struct VertexCacheStats {
+    uint64_t triangles = 0;
+    // distinct vertices the indices reference
+    uint64_t vertices = 0;
+    // vertex shader invocations
+    uint64_t misses = 0;
+
+    // average cache miss ratio, transformed vertices per triangle: 3 without reuse, ~0.5 at best
+    float acmr() const { return triangles ? (float)misses / triangles : 0.0f; }
+    // average transformed vertex ratio, transformed vertices per vertex: 1 is optimal
+    float atvr() const { return vertices ? (float)misses / vertices : 0.0f; }
+
+    VertexCacheStats& operator+=(const VertexCacheStats& other) {
+        triangles += other.triangles;
+        vertices += other.vertices;
+        misses += other.misses;
+        return *this;
+    }
+};
+
+inline VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                                           unsigned cacheSize = VERTEX_CACHE_SIZE) {
+    VertexCacheStats stats;
+    stats.triangles = indexCount / 3;
+    // a vertex is cached while fewer than cacheSize misses happened since it was loaded
+    std::vector<uint64_t> loadedAt(vertexCount, 0);
+    std::vector<bool> used(vertexCount, false);
+    uint64_t time = cacheSize + 1;
+    for (size_t i = 0; i < indexCount; ++i) {
+        uint32_t v = indices[i];
+        if (time - loadedAt[v] > cacheSize) {
+            loadedAt[v] = time++;
+            ++stats.misses;
+        }
+        if (!used[v]) {
+            used[v] = true;
+            ++stats.vertices;
+        }
+    }
+    return stats;
+}
+
+// Merges bitwise identical vertices and rewrites the indices, returns the new vertex count. The
+// first copy of every vertex keeps its relative order.
+template <typename Vertex>
+size_t deduplicateVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+    std::vector<uint32_t> order(vertices.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        int compare = std::memcmp(&vertices[a], &vertices[b], sizeof(Vertex));
+        return compare < 0 || (compare == 0 && a < b);
+    });
+    // every vertex points at the first of its copies, then the firsts are compacted
+    std::vector<uint32_t> remap(vertices.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        bool duplicate = i > 0 && std::memcmp(&vertices[order[i]], &vertices[order[i - 1]], sizeof(Vertex)) == 0;
+        remap[order[i]] = duplicate ? remap[order[i - 1]] : order[i];
+    }
+    size_t unique = 0;
+    for (size_t v = 0; v < vertices.size(); ++v) {
+        if (remap[v] == v) {
+            vertices[unique] = vertices[v];
+            remap[v] = (uint32_t)unique++;
+        } else {
+            remap[v] = remap[remap[v]];
+        }
+    }
+    vertices.resize(unique);
+    for (uint32_t& index : indices)
+        index = remap[index];
+    return unique;
+}
+
+// Tipsify (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced
+// Overdraw"): fans out the triangles around a vertex, then continues with the neighbour that is
+// still in the cache and won't be evicted by its own remaining triangles. clusters receives the
+// first triangle of every run that had to restart outside the cache, optimizeOverdraw() may
+// reorder those runs freely.
+inline void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount,
+                                std::vector<uint32_t>* clusters = nullptr, unsigned cacheSize = VERTEX_CACHE_SIZE) {
+    const size_t triangleCount = indexCount / 3;
+    if (clusters)
+        clusters->clear();
+    if (triangleCount == 0)
+        return;
+
+    // triangles of every vertex (CSR), live counts the ones not emitted yet
+    std::vector<uint32_t> live(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i)
+        ++live[indices[i]];
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v)
+        offsets[v + 1] = offsets[v] + live[v];
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    {
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; ++i)
+            adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+    }
+
+    const std::vector<uint32_t> input(indices, indices + triangleCount * 3);
+    std::vector<uint64_t> loadedAt(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    uint64_t time = cacheSize + 1;
+    size_t output = 0;
+    uint32_t cursor = 0;
+    int64_t fan = input[0];
+    bool restarted = true;
+
+    while (fan >= 0) {
+        if (restarted && clusters)
+            clusters->push_back((uint32_t)(output / 3));
+        candidates.clear();
+        for (uint32_t a = offsets[fan]; a < offsets[fan + 1]; ++a) {
+            uint32_t triangle = adjacency[a];
+            if (emitted[triangle])
+                continue;
+            emitted[triangle] = true;
+            for (int corner = 0; corner < 3; ++corner) {
+                uint32_t v = input[triangle * 3 + corner];
+                indices[output++] = v;
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                --live[v];
+                if (time - loadedAt[v] > cacheSize)
+                    loadedAt[v] = time++;
+            }
+        }
+
+        // the neighbour that stays cached the longest, if its remaining fan won't evict it
+        fan = -1;
+        uint64_t bestPriority = 0;
+        for (uint32_t v : candidates) {
+            if (live[v] == 0)
+                continue;
+            uint64_t priority = 0;
+            if (time - loadedAt[v] + 2 * live[v] <= cacheSize)
+                priority = time - loadedAt[v];
+            if (fan < 0 || priority > bestPriority) {
+                fan = v;
+                bestPriority = priority;
+            }
+        }
+        restarted = fan < 0;
+        // dead end: a recently used vertex with triangles left, then the next one in input order
+        while (fan < 0 && !deadEnd.empty()) {
+            uint32_t v = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[v] > 0)
+                fan = v;
+        }
+        while (fan < 0 && cursor < triangleCount * 3) {
+            uint32_t v = input[cursor++];
+            if (live[v] > 0)
+                fan = v;
+        }
+    }
+}
+
+// Sorts runs of triangles starting at starts so the ones facing away from the mesh's center,
+// which are likely to occlude the rest, come first.
+inline void sortClustersOutsideIn(uint32_t* indices, size_t triangleCount, const std::vector<glm::vec3>& positions,
+                                  const std::vector<uint32_t>& starts) {
+    // area weighted centroid and normal of every cluster
+    struct Cluster {
+        uint32_t first;
+        uint32_t count;
+        float sortKey;
+    };
+    std::vector<Cluster> sorted(starts.size());
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    std::vector<glm::vec3> centroids(starts.size(), glm::vec3(0.0f));
+    std::vector<glm::vec3> normals(starts.size(), glm::vec3(0.0f));
+    for (size_t c = 0; c < starts.size(); ++c) {
+        uint32_t end = c + 1 < starts.size() ? starts[c + 1] : (uint32_t)triangleCount;
+        sorted[c] = Cluster{starts[c], end - starts[c], 0.0f};
+        float area = 0.0f;
+        for (uint32_t t = starts[c]; t < end; ++t) {
+            const glm::vec3& a = positions[indices[t * 3]];
+            const glm::vec3& b = positions[indices[t * 3 + 1]];
+            const glm::vec3& p = positions[indices[t * 3 + 2]];
+            glm::vec3 normal = glm::cross(b - a, p - a);
+            float weight = glm::length(normal);
+            centroids[c] += (a + b + p) * (weight / 3.0f);
+            normals[c] += normal;
+            area += weight;
+        }
+        meshCentroid += centroids[c];
+        meshArea += area;
+        if (area > 0.0f)
+            centroids[c] /= area;
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+    for (size_t c = 0; c < sorted.size(); ++c) {
+        float length = glm::length(normals[c]);
+        sorted[c].sortKey = length > 0.0f ? glm::dot(centroids[c] - meshCentroid, normals[c] / length) : 0.0f;
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) {
+        return a.sortKey > b.sortKey;
+    });
+
+    const std::vector<uint32_t> input(indices, indices + triangleCount * 3);
+    size_t output = 0;
+    for (const Cluster& cluster : sorted) {
+        std::copy(input.begin() + cluster.first * 3, input.begin() + (cluster.first + cluster.count) * 3,
+                  indices + output);
+        output += cluster.count * 3;
+    }
+}
+
+// Reorders the clusters of optimizeVertexCache() outside in to reduce overdraw (Sander et al.,
+// the "linear-speed" variant). Clusters are split further where the part before the cut already
+// has a cache miss ratio within threshold of the mesh's, more clusters sort better but every cut
+// starts with a cold cache. The result may cost at most threshold times the mesh's ratio,
+// otherwise only the clusters of optimizeVertexCache() are sorted.
+inline void optimizeOverdraw(uint32_t* indices, size_t indexCount, const std::vector<glm::vec3>& positions,
+                             const std::vector<uint32_t>& clusters, float threshold = 1.05f,
+                             unsigned cacheSize = VERTEX_CACHE_SIZE) {
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0 || clusters.empty())
+        return;
+    const float meshAcmr = analyzeVertexCache(indices, triangleCount * 3, positions.size(), cacheSize).acmr();
+
+    // soft boundaries: restart the simulation at every cluster and cut once its ratio is good enough
+    std::vector<uint32_t> starts;
+    std::vector<uint64_t> loadedAt(positions.size(), 0);
+    uint64_t time = cacheSize + 1;
+    for (size_t c = 0; c < clusters.size(); ++c) {
+        uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : (uint32_t)triangleCount;
+        uint32_t start = clusters[c];
+        uint64_t misses = 0;
+        time += cacheSize + 1;
+        starts.push_back(start);
+        for (uint32_t t = start; t < end; ++t) {
+            for (int corner = 0; corner < 3; ++corner) {
+                uint32_t v = indices[t * 3 + corner];
+                if (time - loadedAt[v] > cacheSize) {
+                    loadedAt[v] = time++;
+                    ++misses;
+                }
+            }
+            if (t + 1 < end && misses <= (uint64_t)((t - start + 1) * meshAcmr * threshold)) {
+                start = t + 1;
+                misses = 0;
+                time += cacheSize + 1;
+                starts.push_back(start);
+            }
+        }
+    }
+
+    const std::vector<uint32_t> input(indices, indices + triangleCount * 3);
+    sortClustersOutsideIn(indices, triangleCount, positions, starts);
+    if (analyzeVertexCache(indices, triangleCount * 3, positions.size(), cacheSize).acmr() > meshAcmr * threshold) {
+        std::copy(input.begin(), input.end(), indices);
+        sortClustersOutsideIn(indices, triangleCount, positions, clusters);
+    }
+}
+
+// Renumbers the vertices in the order the indices first use them, so the vertex fetch walks the
+// buffer forward. Vertices no index uses are dropped. Returns the new vertex count.
+template <typename Vertex>
+size_t optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+    const uint32_t unused = ~0u;
+    std::vector<uint32_t> remap(vertices.size(), unused);
+    std::vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+    for (uint32_t& index : indices) {
+        if (remap[index] == unused) {
+            remap[index] = (uint32_t)ordered.size();
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(ordered);
+    return vertices.size();
+}
+
+};
+
+#endif //PROJECT_BASE_MESHOPTIMIZER_H
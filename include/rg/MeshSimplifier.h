@@ -0,0 +1,311 @@
+#ifndef PROJECT_BASE_MESHSIMPLIFIER_H
+#define PROJECT_BASE_MESHSIMPLIFIER_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace rg {
+
+// One level of detail inside a mesh's index range. Levels share the vertices of the mesh, only
+// the triangles differ. error is how far (in model units) the level's surface may be from the
+// full mesh.
+struct LodLevel {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error;
+};
+
+// Quadric error metric simplification (Garland and Heckbert) with half-edge collapses: a vertex
+// is merged into one of its neighbours, so no new vertices are made and every level can index
+// the original vertex buffer. The error of a collapse is the area weighted mean squared distance
+// of the new position to the planes of the triangles merged into the vertex.
+//
+// Vertices on open borders, non-manifold edges and attribute seams (several vertices at one
+// position, e.g. a UV split) stay where they are, which keeps silhouettes and texture mapping.
+class MeshSimplifier {
+public:
+    MeshSimplifier(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices)
+    : positions(positions), current(indices) {
+        weld();
+        computeQuadrics();
+        lockBorders();
+    }
+
+    // Collapses edges until at most targetIndexCount indices are left or the next collapse would
+    // move the surface more than maxError. Can be called again with a lower target, the levels of
+    // a chain then build on each other. Returns the error reached so far.
+    float simplify(size_t targetIndexCount, float maxError) {
+        const double maxCost = (double)maxError * maxError;
+        while (current.size() > targetIndexCount) {
+            buildAdjacency();
+            collectCandidates();
+            std::fill(touched.begin(), touched.end(), 0);
+            size_t trianglesToRemove = (current.size() - targetIndexCount + 2) / 3;
+            size_t removed = 0;
+            bool collapsed = false;
+            bool limitReached = false;
+            for (const Collapse& collapse : candidates) {
+                if (collapse.cost > maxCost) {
+                    limitReached = true;
+                    break;
+                }
+                if (touched[collapse.from] || touched[collapse.to] || flips(collapse.from, collapse.to))
+                    continue;
+                removed += apply(collapse);
+                collapsed = true;
+                maxCollapseCost = std::max(maxCollapseCost, collapse.cost);
+                if (removed >= trianglesToRemove)
+                    break;
+            }
+            removeDegenerates();
+            if (!collapsed || limitReached)
+                break;
+        }
+        return error();
+    }
+
+    const std::vector<uint32_t>& indices() const { return current; }
+    float error() const { return (float)std::sqrt(maxCollapseCost); }
+
+    // Appends levels - 1 simplified index lists to indices, each with about ratio times the
+    // triangles of the one before, and returns every level starting with the full mesh. Stops
+    // early when a level can't get at least 10% smaller within maxError.
+    static std::vector<LodLevel> generateLods(const std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices,
+                                              unsigned levels, float ratio, float maxError) {
+        std::vector<LodLevel> lods;
+        lods.push_back(LodLevel{0, (uint32_t)indices.size(), 0.0f});
+        if (levels <= 1 || indices.empty())
+            return lods;
+        MeshSimplifier simplifier(positions, indices);
+        size_t previous = indices.size();
+        for (unsigned level = 1; level < levels; ++level) {
+            size_t target = (size_t)(previous * ratio) / 3 * 3;
+            float error = simplifier.simplify(target, maxError);
+            const std::vector<uint32_t>& simplified = simplifier.indices();
+            if (simplified.empty() || simplified.size() > previous * 9 / 10)
+                break;
+            lods.push_back(LodLevel{(uint32_t)indices.size(), (uint32_t)simplified.size(), error});
+            indices.insert(indices.end(), simplified.begin(), simplified.end());
+            previous = simplified.size();
+        }
+        return lods;
+    }
+
+private:
+    // symmetric 4x4 matrix of the plane equations, weighted by triangle area
+    struct Quadric {
+        double a00 = 0, a01 = 0, a02 = 0, a03 = 0, a11 = 0, a12 = 0, a13 = 0, a22 = 0, a23 = 0, a33 = 0;
+        double weight = 0;
+
+        void addPlane(const glm::dvec3& n, double d, double w) {
+            a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z; a03 += w * n.x * d;
+            a11 += w * n.y * n.y; a12 += w * n.y * n.z; a13 += w * n.y * d;
+            a22 += w * n.z * n.z; a23 += w * n.z * d;
+            a33 += w * d * d;
+            weight += w;
+        }
+        void add(const Quadric& q) {
+            a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03; a11 += q.a11; a12 += q.a12; a13 += q.a13;
+            a22 += q.a22; a23 += q.a23; a33 += q.a33; weight += q.weight;
+        }
+        // sum of weighted squared distances of p to the planes
+        double evaluate(const glm::dvec3& p) const {
+            return a00 * p.x * p.x + 2 * a01 * p.x * p.y + 2 * a02 * p.x * p.z + 2 * a03 * p.x
+                 + a11 * p.y * p.y + 2 * a12 * p.y * p.z + 2 * a13 * p.y
+                 + a22 * p.z * p.z + 2 * a23 * p.z + a33;
+        }
+    };
+
+    struct Collapse {
+        uint32_t from;
+        uint32_t to;
+        double cost;
+    };
+
+    struct PositionKey {
+        float x, y, z;
+        bool operator==(const PositionKey& o) const { return x == o.x && y == o.y && z == o.z; }
+    };
+    struct PositionHash {
+        size_t operator()(const PositionKey& k) const {
+            uint32_t bits[3];
+            std::memcpy(bits, &k, sizeof(bits));
+            return (size_t)bits[0] * 73856093u ^ (size_t)bits[1] * 19349663u ^ (size_t)bits[2] * 83492791u;
+        }
+    };
+
+    const std::vector<glm::vec3>& positions;
+    std::vector<uint32_t> current;
+    // first vertex at the same position, the topology is built on these
+    std::vector<uint32_t> welded;
+    std::vector<uint8_t> locked;
+    std::vector<Quadric> quadrics;
+    // triangles around every welded vertex, rebuilt each pass
+    std::vector<uint32_t> adjacencyOffsets;
+    std::vector<uint32_t> adjacency;
+    std::vector<Collapse> candidates;
+    std::vector<uint8_t> touched;
+    double maxCollapseCost = 0.0;
+
+    uint32_t rep(uint32_t index) const { return welded[index]; }
+
+    void weld() {
+        welded.resize(positions.size());
+        locked.assign(positions.size(), 0);
+        touched.assign(positions.size(), 0);
+        std::unordered_map<PositionKey, uint32_t, PositionHash> first;
+        first.reserve(positions.size());
+        for (uint32_t i = 0; i < (uint32_t)positions.size(); ++i) {
+            const glm::vec3& p = positions[i];
+            auto inserted = first.emplace(PositionKey{p.x, p.y, p.z}, i);
+            welded[i] = inserted.first->second;
+            // a seam: the vertices at this position differ in their other attributes
+            if (!inserted.second)
+                locked[welded[i]] = 1;
+        }
+    }
+
+    void computeQuadrics() {
+        quadrics.assign(positions.size(), Quadric());
+        for (size_t t = 0; t + 2 < current.size(); t += 3) {
+            glm::dvec3 p0(positions[rep(current[t])]), p1(positions[rep(current[t + 1])]), p2(positions[rep(current[t + 2])]);
+            glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+            double length = glm::length(normal);
+            if (length <= 0.0)
+                continue;
+            normal /= length;
+            double d = -glm::dot(normal, p0);
+            for (int k = 0; k < 3; ++k)
+                quadrics[rep(current[t + k])].addPlane(normal, d, length * 0.5);
+        }
+    }
+
+    // edges used by one triangle are open borders, by more than two non-manifold
+    void lockBorders() {
+        std::unordered_map<uint64_t, uint32_t> edgeUses;
+        edgeUses.reserve(current.size());
+        for (size_t t = 0; t + 2 < current.size(); t += 3) {
+            for (int k = 0; k < 3; ++k) {
+                uint32_t a = rep(current[t + k]), b = rep(current[t + (k + 1) % 3]);
+                ++edgeUses[(uint64_t)std::min(a, b) << 32 | std::max(a, b)];
+            }
+        }
+        for (const auto& edge : edgeUses) {
+            if (edge.second != 2) {
+                locked[(uint32_t)(edge.first >> 32)] = 1;
+                locked[(uint32_t)edge.first] = 1;
+            }
+        }
+    }
+
+    void buildAdjacency() {
+        adjacencyOffsets.assign(positions.size() + 1, 0);
+        for (uint32_t index : current)
+            ++adjacencyOffsets[rep(index) + 1];
+        for (size_t i = 1; i < adjacencyOffsets.size(); ++i)
+            adjacencyOffsets[i] += adjacencyOffsets[i - 1];
+        adjacency.resize(current.size());
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (uint32_t i = 0; i < (uint32_t)current.size(); ++i)
+            adjacency[fill[rep(current[i])]++] = i / 3;
+    }
+
+    void collectCandidates() {
+        candidates.clear();
+        for (size_t t = 0; t + 2 < current.size(); t += 3) {
+            for (int k = 0; k < 3; ++k) {
+                uint32_t a = rep(current[t + k]), b = rep(current[t + (k + 1) % 3]);
+                for (int direction = 0; direction < 2; ++direction) {
+                    if (!locked[a]) {
+                        Quadric q = quadrics[a];
+                        q.add(quadrics[b]);
+                        double cost = q.weight > 0.0 ? std::max(q.evaluate(glm::dvec3(positions[b])) / q.weight, 0.0) : 0.0;
+                        candidates.push_back(Collapse{a, b, cost});
+                    }
+                    std::swap(a, b);
+                }
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const Collapse& x, const Collapse& y) {
+            return x.cost != y.cost ? x.cost < y.cost : (x.from != y.from ? x.from < y.from : x.to < y.to);
+        });
+    }
+
+    bool contains(uint32_t triangle, uint32_t welded) const {
+        return rep(current[triangle * 3]) == welded || rep(current[triangle * 3 + 1]) == welded ||
+               rep(current[triangle * 3 + 2]) == welded;
+    }
+
+    // moving from onto to must not turn any of the remaining triangles around
+    bool flips(uint32_t from, uint32_t to) const {
+        for (uint32_t i = adjacencyOffsets[from]; i < adjacencyOffsets[from + 1]; ++i) {
+            uint32_t triangle = adjacency[i];
+            if (contains(triangle, to))
+                continue;
+            glm::vec3 before[3], after[3];
+            for (int k = 0; k < 3; ++k) {
+                uint32_t v = rep(current[triangle * 3 + k]);
+                before[k] = positions[v];
+                after[k] = v == from ? positions[to] : positions[v];
+            }
+            glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+            glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+            if (glm::dot(n0, n1) <= 0.0f)
+                return true;
+        }
+        return false;
+    }
+
+    // returns the number of triangles that collapse
+    size_t apply(const Collapse& collapse) {
+        // the vertex of `to` that the triangles on this side of it use, from has no seam so its
+        // triangles see a single one
+        uint32_t target = collapse.to;
+        size_t removed = 0;
+        for (uint32_t i = adjacencyOffsets[collapse.from]; i < adjacencyOffsets[collapse.from + 1]; ++i) {
+            uint32_t triangle = adjacency[i];
+            if (!contains(triangle, collapse.to))
+                continue;
+            for (int k = 0; k < 3; ++k) {
+                if (rep(current[triangle * 3 + k]) == collapse.to)
+                    target = current[triangle * 3 + k];
+            }
+            ++removed;
+        }
+        for (uint32_t i = adjacencyOffsets[collapse.from]; i < adjacencyOffsets[collapse.from + 1]; ++i) {
+            uint32_t triangle = adjacency[i];
+            for (int k = 0; k < 3; ++k) {
+                uint32_t& index = current[triangle * 3 + k];
+                touched[rep(index)] = 1;
+                if (rep(index) == collapse.from)
+                    index = target;
+            }
+        }
+        touched[collapse.from] = 1;
+        quadrics[collapse.to].add(quadrics[collapse.from]);
+        return removed;
+    }
+
+    void removeDegenerates() {
+        size_t write = 0;
+        for (size_t t = 0; t + 2 < current.size(); t += 3) {
+            uint32_t a = rep(current[t]), b = rep(current[t + 1]), c = rep(current[t + 2]);
+            if (a == b || b == c || a == c)
+                continue;
+            current[write++] = current[t];
+            current[write++] = current[t + 1];
+            current[write++] = current[t + 2];
+        }
+        current.resize(write);
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_MESHSIMPLIFIER_H
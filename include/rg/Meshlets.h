@@ -0,0 +1,176 @@
+#ifndef PROJECT_BASE_MESHLETS_H
+#define PROJECT_BASE_MESHLETS_H
+
+#include <glm/glm.hpp>
+#include <rg/Culling.h>
+#include <rg/MeshOptimizer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace rg {
+
+// A cluster of consecutive triangles of an index list, drawn as a range of the mesh's indices so
+// it needs no index buffer of its own. Culled on its own against the frustum (sphere) and the
+// camera position (normal cone, see rg::backfacing).
+struct Meshlet {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    // model space bounding sphere, center and radius
+    glm::vec4 sphere;
+    // axis and cutoff of the triangle normals, see rg::noCone
+    glm::vec4 cone;
+};
+
+// limits of a cluster, the sizes mesh shading pipelines use
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// Splits indices into clusters of up to maxVertices distinct vertices and maxTriangles triangles
+// and appends them to meshlets, firstIndex relative to indices. The triangles are reordered so
+// every cluster is a contiguous range. A cluster starts at the first triangle left in the input
+// order, so the order of an rg::optimizeOverdraw() list roughly carries over, and grows over
+// the triangles sharing its vertices: the ones adding the fewest vertices first, between those
+// the ones closest to the cluster's average normal. Triangles facing more than 90 degrees away
+// from that normal start another cluster, so the normal cones stay narrow enough to cull. Each
+// cluster is then reordered for the vertex cache on its own; the cuts between clusters cost
+// some of the cache efficiency of the input order.
+inline void buildMeshlets(std::vector<Meshlet>& meshlets, uint32_t* indices, size_t indexCount,
+                          const std::vector<glm::vec3>& positions, uint32_t maxVertices = MESHLET_MAX_VERTICES,
+                          uint32_t maxTriangles = MESHLET_MAX_TRIANGLES) {
+    const uint32_t triangleCount = (uint32_t)(indexCount / 3);
+    if (triangleCount == 0)
+        return;
+    const std::vector<uint32_t> input(indices, indices + triangleCount * 3);
+
+    // triangles of every vertex (CSR) and unit normals
+    std::vector<uint32_t> offsets(positions.size() + 1, 0);
+    for (uint32_t index : input)
+        ++offsets[index + 1];
+    for (size_t v = 0; v < positions.size(); ++v)
+        offsets[v + 1] += offsets[v];
+    std::vector<uint32_t> adjacency(input.size());
+    {
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (uint32_t i = 0; i < (uint32_t)input.size(); ++i)
+            adjacency[fill[input[i]]++] = i / 3;
+    }
+    std::vector<glm::vec3> normals(triangleCount, glm::vec3(0.0f));
+    for (uint32_t t = 0; t < triangleCount; ++t) {
+        const glm::vec3& a = positions[input[t * 3]];
+        glm::vec3 normal = glm::cross(positions[input[t * 3 + 1]] - a, positions[input[t * 3 + 2]] - a);
+        float length = glm::length(normal);
+        if (length > 0.0f)
+            normals[t] = normal / length;
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    // cluster that last used every vertex, counting from 1
+    std::vector<uint32_t> usedBy(positions.size(), 0);
+    std::vector<uint32_t> clusterVertices;
+    std::vector<uint32_t> localIndices;
+    // position of every vertex in clusterVertices while it is in the current cluster
+    std::vector<uint32_t> localVertex(positions.size(), 0);
+    uint32_t cluster = 0;
+    uint32_t seed = 0;
+    uint32_t output = 0;
+    auto newVertices = [&](uint32_t t) {
+        uint32_t added = 0;
+        for (int corner = 0; corner < 3; ++corner)
+            added += usedBy[input[t * 3 + corner]] != cluster;
+        return added;
+    };
+
+    while (true) {
+        while (seed < triangleCount && emitted[seed])
+            ++seed;
+        if (seed == triangleCount)
+            break;
+        ++cluster;
+        clusterVertices.clear();
+        uint32_t first = output / 3;
+        glm::vec3 normalSum(0.0f);
+        uint32_t next = seed;
+        while (true) {
+            emitted[next] = true;
+            normalSum += normals[next];
+            for (int corner = 0; corner < 3; ++corner) {
+                uint32_t v = input[next * 3 + corner];
+                indices[output++] = v;
+                if (usedBy[v] != cluster) {
+                    usedBy[v] = cluster;
+                    localVertex[v] = (uint32_t)clusterVertices.size();
+                    clusterVertices.push_back(v);
+                }
+            }
+            if (output / 3 - first == maxTriangles)
+                break;
+
+            // best neighbour that still fits
+            float axisLength = glm::length(normalSum);
+            glm::vec3 axis = axisLength > 0.0f ? normalSum / axisLength : glm::vec3(0.0f);
+            int64_t best = -1;
+            float bestScore = 0.0f;
+            for (uint32_t v : clusterVertices) {
+                for (uint32_t a = offsets[v]; a < offsets[v + 1]; ++a) {
+                    uint32_t t = adjacency[a];
+                    if (emitted[t] || glm::dot(normals[t], axis) < 0.0f)
+                        continue;
+                    uint32_t added = newVertices(t);
+                    if (clusterVertices.size() + added > maxVertices)
+                        continue;
+                    float score = (float)added + (1.0f - glm::dot(normals[t], axis));
+                    if (best < 0 || score < bestScore) {
+                        best = t;
+                        bestScore = score;
+                    }
+                }
+            }
+            if (best < 0)
+                break;
+            next = (uint32_t)best;
+        }
+
+        localIndices.resize(output - first * 3);
+        for (size_t i = 0; i < localIndices.size(); ++i)
+            localIndices[i] = localVertex[indices[first * 3 + i]];
+        optimizeVertexCache(localIndices.data(), localIndices.size(), clusterVertices.size());
+        for (size_t i = 0; i < localIndices.size(); ++i)
+            indices[first * 3 + i] = clusterVertices[localIndices[i]];
+
+        // sphere around the box of the vertices, cone around the unit triangle normals
+        glm::vec3 lo = positions[clusterVertices[0]], hi = lo;
+        for (uint32_t v : clusterVertices) {
+            lo = glm::min(lo, positions[v]);
+            hi = glm::max(hi, positions[v]);
+        }
+        glm::vec3 center = (lo + hi) * 0.5f;
+        float radius = 0.0f;
+        for (uint32_t v : clusterVertices)
+            radius = std::max(radius, glm::length(positions[v] - center));
+
+        glm::vec4 cone = noCone();
+        float axisLength = glm::length(normalSum);
+        if (axisLength > 0.0f) {
+            glm::vec3 axis = normalSum / axisLength;
+            float minDot = 1.0f;
+            for (uint32_t i = first * 3; i < output; i += 3) {
+                const glm::vec3& a = positions[indices[i]];
+                glm::vec3 normal = glm::cross(positions[indices[i + 1]] - a, positions[indices[i + 2]] - a);
+                float length = glm::length(normal);
+                if (length > 0.0f)
+                    minDot = std::min(minDot, glm::dot(normal / length, axis));
+            }
+            // normals more than ~84 degrees apart from the axis make the cone useless
+            if (minDot > 0.1f)
+                cone = glm::vec4(axis, std::sqrt(1.0f - minDot * minDot));
+        }
+        meshlets.push_back(Meshlet{first * 3, output - first * 3, glm::vec4(center, radius), cone});
+    }
+}
+
+};
+
+#endif //PROJECT_BASE_MESHLETS_H
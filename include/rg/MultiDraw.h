@@ -0,0 +1,175 @@
+#ifndef PROJECT_BASE_MULTIDRAW_H
+#define PROJECT_BASE_MULTIDRAW_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <rg/Culling.h>
+#include <rg/GlExtensions.h>
+#include <rg/RenderStats.h>
+#include <rg/StreamBuffer.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace rg {
+
+// glMultiDrawElementsIndirect record, laid out as GL reads it from GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand {
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    uint32_t baseInstance;
+};
+static_assert(sizeof(DrawElementsIndirectCommand) == 20, "indirect commands are five tightly packed words");
+
+// One frame of indexed draws from a geometry pool, grouped by material. Every draw has an
+// Instance record (e.g. its model matrix) and its command's baseInstance is the index of that
+// record, so an instanced attribute with divisor 1 over the instance buffer gives the vertex
+// shader the draw's data without gl_DrawID. A group is one glMultiDrawElementsIndirect call.
+//
+// Every draw also has a world space bounding sphere and normal cone, build() can drop the draws
+// outside a frustum or facing away from the camera and rg::GpuCulling tests the rest on the GPU.
+// The arrays keep their capacity across frames, a steady scene doesn't allocate.
+//
+// The instances and commands are written to the frame's StreamBuffer. The instances start at a
+// multiple of sizeof(Instance) and the uploaded baseInstances count from the start of the buffer,
+// so the instanced attributes stay attached at offset 0 of instanceBuffer() from frame to frame.
+template <typename Instance>
+class IndirectDrawList {
+public:
+    struct Group {
+        uint64_t material;
+        // what the caller binds for the group, e.g. the first mesh with this material
+        const void* user;
+        uint32_t firstCommand;
+        uint32_t commandCount;
+    };
+
+    void clear() {
+        items.clear();
+        groupList.clear();
+    }
+
+    void add(uint64_t material, const void* user, uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex,
+             const Instance& instance, const glm::vec4& sphere, const glm::vec4& cone = noCone()) {
+        if (indexCount == 0)
+            return;
+        items.push_back(Item{material, user, DrawElementsIndirectCommand{indexCount, 1, firstIndex, baseVertex, 0},
+                             instance, sphere, cone});
+    }
+
+    // sorts the draws by material and writes the commands and instances in that order, without the
+    // draws outside the frustum if there is one and the back-facing ones if there is an eye
+    void build(const Frustum* frustum = nullptr, const glm::vec3* eye = nullptr) {
+        order.resize(items.size());
+        for (uint32_t i = 0; i < (uint32_t)items.size(); ++i)
+            order[i] = i;
+        // ties keep the submission order, so equal frames build equal lists
+        std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+            return items[a].material != items[b].material ? items[a].material < items[b].material : a < b;
+        });
+        commandList.clear();
+        instanceList.clear();
+        boundsList.clear();
+        coneList.clear();
+        groupList.clear();
+        for (uint32_t index : order) {
+            const Item& item = items[index];
+            if ((frustum && !frustum->intersects(item.sphere)) || (eye && backfacing(item.sphere, item.cone, *eye)))
+                continue;
+            uint32_t i = (uint32_t)commandList.size();
+            commandList.push_back(item.command);
+            commandList.back().baseInstance = i;
+            instanceList.push_back(item.instance);
+            boundsList.push_back(item.sphere);
+            coneList.push_back(item.cone);
+            if (groupList.empty() || groupList.back().material != item.material)
+                groupList.push_back(Group{item.material, item.user, i, 0});
+            ++groupList.back().commandCount;
+        }
+    }
+
+    // writes both arrays to the ring, the commands where rg::GpuCulling can bind them as a storage
+    // buffer. Without multi-draw the draws are issued from the CPU copies (submitEach).
+    void upload(StreamBuffer& ring) {
+        if (commandList.empty() || !glInfo().multiDrawIndirect)
+            return;
+        const size_t commandAlignment = std::max<size_t>(glInfo().shaderStorageAlignment, sizeof(uint32_t));
+        // both in the same buffer, the commands refer to the instances
+        ring.reserve(instanceList.size() * sizeof(Instance) + commandList.size() * sizeof(DrawElementsIndirectCommand) +
+                     sizeof(Instance) + commandAlignment);
+        GLintptr instanceOffset = ring.write(instanceList.data(), instanceList.size(), sizeof(Instance));
+        uint32_t firstInstance = (uint32_t)(instanceOffset / sizeof(Instance));
+        StreamBuffer::Allocation allocation =
+                ring.allocate(commandList.size() * sizeof(DrawElementsIndirectCommand), commandAlignment);
+        DrawElementsIndirectCommand* out = (DrawElementsIndirectCommand*)allocation.data;
+        for (const DrawElementsIndirectCommand& command : commandList) {
+            *out = command;
+            out->baseInstance += firstInstance;
+            ++out;
+        }
+        ring.flush();
+        ringBuffer = ring.buffer();
+        commandStart = allocation.offset;
+    }
+
+    // every draw of the group in one call, the pool's vertex array has to be bound
+    void submit(const Group& group, GLenum mode = GL_TRIANGLES) const {
+        FrameStats& stats = RenderStats::current();
+        ++stats.drawCalls;
+        for (uint32_t i = 0; i < group.commandCount; ++i)
+            stats.triangles += gl::primitiveTriangles(mode, commandList[group.firstCommand + i].count);
+        size_t offset = (size_t)commandStart + (size_t)group.firstCommand * sizeof(DrawElementsIndirectCommand);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, ringBuffer);
+        glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, (const void*)offset, group.commandCount, 0);
+    }
+
+    // the 3.3 path, one glDrawElementsBaseVertex per draw after perDraw(instance) set its uniforms
+    template <typename PerDraw>
+    void submitEach(const Group& group, PerDraw perDraw, GLenum mode = GL_TRIANGLES) const {
+        for (uint32_t i = group.firstCommand; i < group.firstCommand + group.commandCount; ++i) {
+            const DrawElementsIndirectCommand& command = commandList[i];
+            perDraw(instanceList[i]);
+            gl::DrawElementsBaseVertex(mode, command.count, GL_UNSIGNED_INT,
+                                       (const void*)((size_t)command.firstIndex * sizeof(uint32_t)), command.baseVertex);
+        }
+    }
+
+    // the ring buffer of the last upload(), attached to the pool's vertex array as the per-draw
+    // attributes
+    GLuint instanceBuffer() const { return ringBuffer; }
+    // the uploaded commands, in build() order, start at commandOffset() bytes into commandBuffer()
+    GLuint commandBuffer() const { return ringBuffer; }
+    GLintptr commandOffset() const { return commandStart; }
+    const std::vector<Group>& groups() const { return groupList; }
+    const std::vector<DrawElementsIndirectCommand>& commandData() const { return commandList; }
+    const std::vector<Instance>& instanceData() const { return instanceList; }
+    const std::vector<glm::vec4>& boundsData() const { return boundsList; }
+    const std::vector<glm::vec4>& coneData() const { return coneList; }
+
+private:
+    struct Item {
+        uint64_t material;
+        const void* user;
+        DrawElementsIndirectCommand command;
+        Instance instance;
+        glm::vec4 sphere;
+        glm::vec4 cone;
+    };
+
+    std::vector<Item> items;
+    std::vector<uint32_t> order;
+    std::vector<DrawElementsIndirectCommand> commandList;
+    std::vector<Instance> instanceList;
+    std::vector<glm::vec4> boundsList;
+    std::vector<glm::vec4> coneList;
+    std::vector<Group> groupList;
+    GLuint ringBuffer = 0;
+    GLintptr commandStart = 0;
+};
+
+};
+
+#endif //PROJECT_BASE_MULTIDRAW_H
@@ -0,0 +1,162 @@
+#ifndef PROJECT_BASE_PROFILER_H
+#define PROJECT_BASE_PROFILER_H
+
+// CPU zone profiler. Built only with -DRG_PROFILE (cmake -DRG_ENABLE_PROFILER=ON), otherwise
+// PROFILE_ZONE/PROFILE_FUNCTION expand to nothing and cost nothing.
+//
+//   void Model::loadModel(...) {
+//       PROFILE_FUNCTION();
+//       ...
+//   }
+//
+// Every thread records into its own ring buffer, the oldest zones get overwritten once it is
+// full. writeChromeTrace() dumps all of them as Chrome trace / Perfetto JSON.
+
+#include <string>
+
+#ifdef RG_PROFILE
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#define RG_PROFILE_CONCAT_IMPL(a, b) a##b
+#define RG_PROFILE_CONCAT(a, b) RG_PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_ZONE(name) rg::ProfileZone RG_PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
+
+namespace rg {
+
+const unsigned int PROFILER_RING_SIZE = 1 << 16;
+
+struct ProfileEvent {
+    const char* name;
+    uint64_t startNs;
+    uint64_t endNs;
+};
+
+struct ProfileThreadBuffer {
+    ProfileEvent events[PROFILER_RING_SIZE];
+    uint64_t written = 0;
+    unsigned int threadId = 0;
+};
+
+class Profiler {
+public:
+    static uint64_t nowNs() {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static void record(const char* name, uint64_t startNs, uint64_t endNs) {
+        ProfileThreadBuffer& buffer = threadBuffer();
+        ProfileEvent& event = buffer.events[buffer.written % PROFILER_RING_SIZE];
+        event.name = name;
+        event.startNs = startNs;
+        event.endNs = endNs;
+        ++buffer.written;
+    }
+
+    // Call while no other thread is recording, e.g. at shutdown.
+    static bool writeChromeTrace(const std::string& path) {
+        std::ofstream out(path);
+        if (!out) {
+            std::cerr << "Failed to write profiler trace to " << path << '\n';
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(registryMutex());
+        uint64_t origin = UINT64_MAX;
+        for (ProfileThreadBuffer* buffer : registry()) {
+            uint64_t count = buffer->written < PROFILER_RING_SIZE ? buffer->written : PROFILER_RING_SIZE;
+            for (uint64_t i = buffer->written - count; i < buffer->written; ++i)
+                origin = std::min(origin, buffer->events[i % PROFILER_RING_SIZE].startNs);
+        }
+
+        out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+        bool first = true;
+        for (ProfileThreadBuffer* buffer : registry()) {
+            uint64_t count = buffer->written < PROFILER_RING_SIZE ? buffer->written : PROFILER_RING_SIZE;
+            for (uint64_t i = buffer->written - count; i < buffer->written; ++i) {
+                const ProfileEvent& event = buffer->events[i % PROFILER_RING_SIZE];
+                // timestamps are in microseconds, the fraction keeps nanosecond precision
+                out << (first ? "" : ",\n")
+                    << "{\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 1"
+                    << ", \"tid\": " << buffer->threadId
+                    << ", \"ts\": " << (event.startNs - origin) / 1000 << '.' << pad((event.startNs - origin) % 1000)
+                    << ", \"dur\": " << (event.endNs - event.startNs) / 1000 << '.' << pad((event.endNs - event.startNs) % 1000)
+                    << "}";
+                first = false;
+            }
+        }
+        out << "\n]}\n";
+        std::cerr << "Profiler trace written to " << path << '\n';
+        return true;
+    }
+
+private:
+    static ProfileThreadBuffer& threadBuffer() {
+        // buffers are never freed so zones of finished threads still end up in the trace
+        static thread_local ProfileThreadBuffer* buffer = registerThread();
+        return *buffer;
+    }
+
+    static ProfileThreadBuffer* registerThread() {
+        ProfileThreadBuffer* buffer = new ProfileThreadBuffer;
+        std::lock_guard<std::mutex> lock(registryMutex());
+        buffer->threadId = (unsigned int)registry().size() + 1;
+        registry().push_back(buffer);
+        return buffer;
+    }
+
+    static std::vector<ProfileThreadBuffer*>& registry() {
+        static std::vector<ProfileThreadBuffer*> buffers;
+        return buffers;
+    }
+
+    static std::mutex& registryMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    static std::string pad(uint64_t ns) {
+        std::string digits = std::to_string(ns);
+        return std::string(3 - digits.size(), '0') + digits;
+    }
+};
+
+class ProfileZone {
+public:
+    explicit ProfileZone(const char* name)
+    : name(name), start(Profiler::nowNs()) {}
+    ~ProfileZone() { Profiler::record(name, start, Profiler::nowNs()); }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+private:
+    const char* name;
+    uint64_t start;
+};
+
+};
+
+#else
+
+#define PROFILE_ZONE(name) do {} while (0)
+#define PROFILE_FUNCTION() do {} while (0)
+
+namespace rg {
+
+class Profiler {
+public:
+    static bool writeChromeTrace(const std::string&) { return false; }
+};
+
+};
+
+#endif
+
+#endif //PROJECT_BASE_PROFILER_H
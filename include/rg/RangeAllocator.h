@@ -0,0 +1,87 @@
+#ifndef PROJECT_BASE_RANGEALLOCATOR_H
+#define PROJECT_BASE_RANGEALLOCATOR_H
+
+#include <cstdint>
+#include <iterator>
+#include <map>
+
+namespace rg {
+
+// Sub-allocates [0, capacity) in units of elements, e.g. vertices of a shared buffer. First fit
+// over a free list ordered by offset; freed ranges merge with their free neighbours, so a pool
+// that is filled and emptied again ends up as one free range.
+class RangeAllocator {
+public:
+    static const uint32_t INVALID = ~0u;
+
+    // offset of count free elements, INVALID when no free range is large enough
+    uint32_t allocate(uint32_t count) {
+        if (count == 0)
+            return INVALID;
+        for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+            if (it->second < count)
+                continue;
+            uint32_t offset = it->first;
+            uint32_t remaining = it->second - count;
+            freeRanges.erase(it);
+            if (remaining > 0)
+                freeRanges.emplace(offset + count, remaining);
+            allocated += count;
+            return offset;
+        }
+        return INVALID;
+    }
+
+    void free(uint32_t offset, uint32_t count) {
+        if (offset == INVALID || count == 0)
+            return;
+        allocated -= count;
+        auto next = freeRanges.lower_bound(offset);
+        if (next != freeRanges.begin()) {
+            auto previous = std::prev(next);
+            if (previous->first + previous->second == offset) {
+                offset = previous->first;
+                count += previous->second;
+                freeRanges.erase(previous);
+            }
+        }
+        if (next != freeRanges.end() && offset + count == next->first) {
+            count += next->second;
+            freeRanges.erase(next);
+        }
+        freeRanges.emplace(offset, count);
+    }
+
+    // the new elements are free, existing offsets stay valid
+    void grow(uint32_t newCapacity) {
+        if (newCapacity <= total)
+            return;
+        uint32_t added = newCapacity - total;
+        uint32_t offset = total;
+        total = newCapacity;
+        allocated += added;
+        free(offset, added);
+    }
+
+    uint32_t capacity() const { return total; }
+    uint32_t used() const { return allocated; }
+    size_t freeRangeCount() const { return freeRanges.size(); }
+
+    // the largest allocation that would succeed right now
+    uint32_t largestFreeRange() const {
+        uint32_t largest = 0;
+        for (const auto& range : freeRanges)
+            if (range.second > largest)
+                largest = range.second;
+        return largest;
+    }
+
+private:
+    std::map<uint32_t, uint32_t> freeRanges; // offset -> count
+    uint32_t total = 0;
+    uint32_t allocated = 0;
+};
+
+};
+
+#endif //PROJECT_BASE_RANGEALLOCATOR_H
@@ -0,0 +1,262 @@
+#ifndef PROJECT_BASE_RENDERSTATS_H
+#define PROJECT_BASE_RENDERSTATS_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace rg {
+
+struct FrameStats {
+    uint64_t drawCalls = 0;
+    uint64_t triangles = 0;
+    uint64_t programBinds = 0;
+    uint64_t vertexArrayBinds = 0;
+    uint64_t textureBinds = 0;
+    uint64_t uniformUploads = 0;
+    uint64_t bufferBytes = 0;
+    uint64_t textureBytes = 0;
+
+    FrameStats& operator+=(const FrameStats& other) {
+        drawCalls += other.drawCalls;
+        triangles += other.triangles;
+        programBinds += other.programBinds;
+        vertexArrayBinds += other.vertexArrayBinds;
+        textureBinds += other.textureBinds;
+        uniformUploads += other.uniformUploads;
+        bufferBytes += other.bufferBytes;
+        textureBytes += other.textureBytes;
+        return *this;
+    }
+};
+
+const unsigned int RENDER_STATS_HISTORY = 1024;
+
+// Per frame counters filled by the rg::gl wrappers below. Everything issued before the first
+// endFrame() (asset loading) ends up in frame 0.
+class RenderStats {
+public:
+    static FrameStats& current() {
+        static FrameStats stats;
+        return stats;
+    }
+
+    // closes the current frame, keeps it in the history and starts counting the next one
+    static void endFrame() {
+        State& s = state();
+        s.history[s.frames % RENDER_STATS_HISTORY] = current();
+        s.totals += current();
+        ++s.totalFrames;
+        ++s.frames;
+        current() = FrameStats();
+    }
+
+    static const FrameStats& lastFrame() {
+        const State& s = state();
+        static const FrameStats empty;
+        return s.frames ? s.history[(s.frames - 1) % RENDER_STATS_HISTORY] : empty;
+    }
+
+    // averages since the last resetTotals(), used by benchmark sweeps
+    static void resetTotals() {
+        state().totals = FrameStats();
+        state().totalFrames = 0;
+    }
+    static const FrameStats& totals() { return state().totals; }
+    static uint64_t totalFrames() { return state().totalFrames; }
+
+    // writes the last RENDER_STATS_HISTORY frames, one row per frame
+    static bool writeCsv(const std::string& path) {
+        std::ofstream out(path);
+        if (!out) {
+            std::cerr << "Failed to write render stats to " << path << '\n';
+            return false;
+        }
+        const State& s = state();
+        out << "frame,drawCalls,triangles,programBinds,vertexArrayBinds,textureBinds,uniformUploads,bufferBytes,textureBytes\n";
+        uint64_t first = s.frames > RENDER_STATS_HISTORY ? s.frames - RENDER_STATS_HISTORY : 0;
+        for (uint64_t frame = first; frame < s.frames; ++frame) {
+            const FrameStats& f = s.history[frame % RENDER_STATS_HISTORY];
+            out << frame << ',' << f.drawCalls << ',' << f.triangles << ',' << f.programBinds << ','
+                << f.vertexArrayBinds << ',' << f.textureBinds << ',' << f.uniformUploads << ','
+                << f.bufferBytes << ',' << f.textureBytes << '\n';
+        }
+        std::cerr << "Render stats written to " << path << '\n';
+        return true;
+    }
+
+private:
+    struct State {
+        FrameStats history[RENDER_STATS_HISTORY];
+        FrameStats totals;
+        uint64_t totalFrames = 0;
+        uint64_t frames = 0;
+    };
+
+    static State& state() {
+        static State s;
+        return s;
+    }
+};
+
+// Thin wrappers over the GL calls the renderer uses, each one forwards the call and updates
+// RenderStats::current().
+namespace gl {
+
+    inline uint64_t primitiveTriangles(GLenum mode, GLsizei count) {
+        switch (mode) {
+            case GL_TRIANGLES: return (uint64_t)count / 3;
+            case GL_TRIANGLE_STRIP:
+            case GL_TRIANGLE_FAN: return count > 2 ? (uint64_t)count - 2 : 0;
+            default: return 0;
+        }
+    }
+
+    inline uint64_t pixelBytes(GLenum format, GLenum type) {
+        uint64_t components = 4;
+        switch (format) {
+            case GL_RED: components = 1; break;
+            case GL_RG: components = 2; break;
+            case GL_RGB:
+            case GL_BGR: components = 3; break;
+        }
+        switch (type) {
+            case GL_UNSIGNED_SHORT:
+            case GL_HALF_FLOAT: return components * 2;
+            case GL_FLOAT: return components * 4;
+            default: return components;
+        }
+    }
+
+    inline void UseProgram(GLuint program) {
+        ++RenderStats::current().programBinds;
+        glUseProgram(program);
+    }
+
+    // last vertex array bound through BindVertexArray, binding it again is skipped
+    inline GLuint& boundVertexArray() {
+        static GLuint vao = 0;
+        return vao;
+    }
+
+    inline void BindVertexArray(GLuint vao) {
+        if (vao == boundVertexArray())
+            return;
+        boundVertexArray() = vao;
+        ++RenderStats::current().vertexArrayBinds;
+        glBindVertexArray(vao);
+    }
+
+    inline void BindTexture(GLenum target, GLuint texture) {
+        ++RenderStats::current().textureBinds;
+        glBindTexture(target, texture);
+    }
+
+    inline void DrawArrays(GLenum mode, GLint first, GLsizei count) {
+        FrameStats& stats = RenderStats::current();
+        ++stats.drawCalls;
+        stats.triangles += primitiveTriangles(mode, count);
+        glDrawArrays(mode, first, count);
+    }
+
+    inline void DrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) {
+        FrameStats& stats = RenderStats::current();
+        ++stats.drawCalls;
+        stats.triangles += primitiveTriangles(mode, count);
+        glDrawElements(mode, count, type, indices);
+    }
+
+    inline void DrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void* indices, GLint baseVertex) {
+        FrameStats& stats = RenderStats::current();
+        ++stats.drawCalls;
+        stats.triangles += primitiveTriangles(mode, count);
+        glDrawElementsBaseVertex(mode, count, type, (void*)indices, baseVertex);
+    }
+
+    inline void BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+        RenderStats::current().bufferBytes += data ? (uint64_t)size : 0;
+        glBufferData(target, size, data, usage);
+    }
+
+    inline void BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+        RenderStats::current().bufferBytes += (uint64_t)size;
+        glBufferSubData(target, offset, size, data);
+    }
+
+    inline void TexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height,
+                           GLint border, GLenum format, GLenum type, const void* pixels) {
+        if (pixels)
+            RenderStats::current().textureBytes += (uint64_t)width * height * pixelBytes(format, type);
+        glTexImage2D(target, level, internalFormat, width, height, border, format, type, pixels);
+    }
+
+    // pixels is an offset when a pixel unpack buffer is bound, the bytes count either way
+    inline void TexSubImage2D(GLenum target, GLint level, GLint x, GLint y, GLsizei width, GLsizei height,
+                              GLenum format, GLenum type, const void* pixels) {
+        RenderStats::current().textureBytes += (uint64_t)width * height * pixelBytes(format, type);
+        glTexSubImage2D(target, level, x, y, width, height, format, type, pixels);
+    }
+
+    inline void Uniform1i(GLint location, GLint v) {
+        ++RenderStats::current().uniformUploads;
+        glUniform1i(location, v);
+    }
+
+    inline void Uniform1f(GLint location, GLfloat v) {
+        ++RenderStats::current().uniformUploads;
+        glUniform1f(location, v);
+    }
+
+    inline void Uniform2f(GLint location, GLfloat x, GLfloat y) {
+        ++RenderStats::current().uniformUploads;
+        glUniform2f(location, x, y);
+    }
+
+    inline void Uniform2fv(GLint location, GLsizei count, const GLfloat* v) {
+        ++RenderStats::current().uniformUploads;
+        glUniform2fv(location, count, v);
+    }
+
+    inline void Uniform3f(GLint location, GLfloat x, GLfloat y, GLfloat z) {
+        ++RenderStats::current().uniformUploads;
+        glUniform3f(location, x, y, z);
+    }
+
+    inline void Uniform3fv(GLint location, GLsizei count, const GLfloat* v) {
+        ++RenderStats::current().uniformUploads;
+        glUniform3fv(location, count, v);
+    }
+
+    inline void Uniform4f(GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w) {
+        ++RenderStats::current().uniformUploads;
+        glUniform4f(location, x, y, z, w);
+    }
+
+    inline void Uniform4fv(GLint location, GLsizei count, const GLfloat* v) {
+        ++RenderStats::current().uniformUploads;
+        glUniform4fv(location, count, v);
+    }
+
+    inline void UniformMatrix2fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* v) {
+        ++RenderStats::current().uniformUploads;
+        glUniformMatrix2fv(location, count, transpose, v);
+    }
+
+    inline void UniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* v) {
+        ++RenderStats::current().uniformUploads;
+        glUniformMatrix3fv(location, count, transpose, v);
+    }
+
+    inline void UniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* v) {
+        ++RenderStats::current().uniformUploads;
+        glUniformMatrix4fv(location, count, transpose, v);
+    }
+
+};
+
+};
+
+#endif //PROJECT_BASE_RENDERSTATS_H
@@ -0,0 +1,275 @@
+#ifndef PROJECT_BASE_SCENEGENERATOR_H
+#define PROJECT_BASE_SCENEGENERATOR_H
+
+#include <glm/glm.hpp>
+#include <rg/Culling.h>
+#include <rg/TextureUploader.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// upper bound of the pointLights[] array in lights.fs
+const unsigned int MAX_POINT_LIGHTS = 32;
+
+// Describes how many instances of each scene object to spawn. With randomLayout off the
+// hand-placed scene is used for the first objects and only the extra ones are scattered.
+struct SceneConfig {
+    unsigned int containers = 10;
+    unsigned int rocks = 4;
+    unsigned int lights = 4;
+    unsigned int windows = 4;
+    unsigned int dragons = 1;
+    unsigned int seed = 1;
+    float extent = 12.0f;
+    bool randomLayout = false;
+};
+
+struct SceneLayout {
+    std::vector<glm::vec3> containers;
+    std::vector<glm::vec3> rocks;
+    std::vector<glm::vec3> pointLights;
+    std::vector<glm::vec3> windows;
+    std::vector<glm::vec3> dragons;
+};
+
+class SceneGenerator {
+public:
+    static SceneLayout generate(const SceneConfig& config, glm::vec3 dragonPosition) {
+        std::mt19937 rng(config.seed);
+        SceneLayout layout;
+
+        const glm::vec3 containers[] = {
+                glm::vec3( 0.0f,  0.0f,  0.0f),
+                glm::vec3( 2.0f,  5.0f, -15.0f),
+                glm::vec3(-1.5f, -2.2f, -2.5f),
+                glm::vec3(-3.8f, -2.0f, -12.3f),
+                glm::vec3( 2.4f, -0.4f, -3.5f),
+                glm::vec3(-1.7f,  3.0f, -7.5f),
+                glm::vec3( 1.3f, -2.0f, -2.5f),
+                glm::vec3( 1.5f,  2.0f, -2.5f),
+                glm::vec3( 1.5f,  0.2f, -1.5f),
+                glm::vec3(-1.3f,  1.0f, -1.5f)
+        };
+        const glm::vec3 pointLights[] = {
+                glm::vec3( 0.7f,  0.2f,  2.0f),
+                glm::vec3( 1.5f, -1.3f, -2.0f),
+                glm::vec3(-2.0f,  2.0f, -4.0f),
+                glm::vec3( 1.0f,  1.0f, -3.0f)
+        };
+        const glm::vec3 rocks[] = {
+                glm::vec3( 3.0f, 4.1f,  -5.0f),
+                glm::vec3( 4.5f, -2.5f, -8.3f),
+                glm::vec3(-4.4f,  5.6f, -9.0f),
+                glm::vec3( -3.0f,  -3.2f, -6.4f)
+        };
+        const glm::vec3 windows[] = {
+                glm::vec3( 3.0f,  4.1f,  -3.0f),
+                glm::vec3( 3.0f, 4.1f, -7.0f),
+                glm::vec3(-3.0f,  -3.2f, -9.1f),
+                glm::vec3( 1.0f,  1.0f, -10.9f)
+        };
+
+        fill(layout.containers, config.containers, containers, 10, config, rng);
+        fill(layout.rocks, config.rocks, rocks, 4, config, rng);
+        fill(layout.pointLights, std::min(config.lights, MAX_POINT_LIGHTS), pointLights, 4, config, rng);
+        fill(layout.windows, config.windows, windows, 4, config, rng);
+        fill(layout.dragons, config.dragons, &dragonPosition, 1, config, rng);
+        return layout;
+    }
+
+private:
+    static void fill(std::vector<glm::vec3>& out, unsigned int count, const glm::vec3* defaults,
+                     unsigned int defaultCount, const SceneConfig& config, std::mt19937& rng) {
+        std::uniform_real_distribution<float> xy(-config.extent, config.extent);
+        std::uniform_real_distribution<float> z(-2.0f * config.extent, 0.0f);
+        out.clear();
+        out.reserve(count);
+        for (unsigned int i = 0; i < count; ++i) {
+            if (!config.randomLayout && i < defaultCount) {
+                out.push_back(defaults[i]);
+            } else {
+                float x = xy(rng);
+                float y = xy(rng) * 0.5f;
+                out.push_back(glm::vec3(x, y, z(rng)));
+            }
+        }
+    }
+};
+
+// a whole decimal number that fits unsigned int, nothing before or after it
+inline bool parseUnsigned(const char* text, unsigned int& value) {
+    // strtoul skips leading spaces and accepts a minus sign, wrapping the value around
+    if (!std::isdigit((unsigned char)text[0]))
+        return false;
+    char* end = nullptr;
+    errno = 0;
+    unsigned long parsed = std::strtoul(text, &end, 10);
+    if (*end != '\0' || errno == ERANGE || parsed > std::numeric_limits<unsigned int>::max())
+        return false;
+    value = (unsigned int)parsed;
+    return true;
+}
+
+// "scale" multiplies every object count of the configuration
+inline bool applySceneParameter(SceneConfig& config, const std::string& name, unsigned int value) {
+    if (name == "containers") config.containers = value;
+    else if (name == "rocks") config.rocks = value;
+    else if (name == "lights") config.lights = value;
+    else if (name == "windows") config.windows = value;
+    else if (name == "dragons") config.dragons = value;
+    else if (name == "seed") config.seed = value;
+    else if (name == "scale") {
+        config.containers *= value;
+        config.rocks *= value;
+        config.lights *= value;
+        config.windows *= value;
+        config.dragons *= value;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+inline bool isSceneParameter(const std::string& name) {
+    SceneConfig probe;
+    return applySceneParameter(probe, name, 0);
+}
+
+// Expands sweep specifications of the form "param=v1,v2,..." into the cartesian product of
+// scene configurations.
+inline bool expandSweep(const SceneConfig& base, const std::vector<std::string>& specs,
+                        std::vector<SceneConfig>& configs) {
+    configs.assign(1, base);
+    for (const std::string& spec : specs) {
+        size_t eq = spec.find('=');
+        if (eq == std::string::npos) {
+            std::cerr << "Invalid sweep specification: " << spec << '\n';
+            return false;
+        }
+        std::string name = spec.substr(0, eq);
+        std::vector<unsigned int> values;
+        std::stringstream ss(spec.substr(eq + 1));
+        std::string value;
+        while (std::getline(ss, value, ',')) {
+            unsigned int v = 0;
+            if (!parseUnsigned(value.c_str(), v)) {
+                std::cerr << "Invalid sweep value: " << spec << '\n';
+                return false;
+            }
+            values.push_back(v);
+        }
+        if (values.empty()) {
+            std::cerr << "Sweep specification without values: " << spec << '\n';
+            return false;
+        }
+
+        std::vector<SceneConfig> expanded;
+        for (const SceneConfig& config : configs) {
+            for (unsigned int v : values) {
+                SceneConfig c = config;
+                if (!applySceneParameter(c, name, v)) {
+                    std::cerr << "Unknown sweep parameter: " << name << '\n';
+                    return false;
+                }
+                expanded.push_back(c);
+            }
+        }
+        configs.swap(expanded);
+    }
+    return true;
+}
+
+struct CommandLineOptions {
+    SceneConfig scene;
+    std::vector<std::string> sweep;
+    std::string benchmarkOutput;
+    // written at exit when built with RG_ENABLE_PROFILER
+    std::string traceOutput = "trace.json";
+    // per frame render stats of the last frames, written at exit
+    std::string statsOutput;
+    // fail the sweep when a measured frame allocates heap memory
+    bool checkAllocations = false;
+    // recompile shaders when files in resources/shaders change
+    bool hotReload = false;
+    unsigned int warmupFrames = 30;
+    unsigned int measureFrames = 120;
+    // bytes of texels uploaded per frame
+    size_t textureBudget = TEXTURE_UPLOAD_BUDGET;
+    CullMode culling = CullMode::Frustum;
+};
+
+// --containers N --rocks M --lights K --windows W --dragons D --seed S --random
+// --sweep param=v1,v2 (repeatable) --warmup F --frames F --bench-out file.json --trace-out file.json
+// --stats-csv file.csv --check-allocations --hot-reload --culling off|frustum|hiz --texture-budget MB
+inline bool parseCommandLine(int argc, char** argv, CommandLineOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--random") {
+            options.scene.randomLayout = true;
+        } else if (arg == "--check-allocations") {
+            options.checkAllocations = true;
+        } else if (arg == "--hot-reload") {
+            options.hotReload = true;
+        } else if (arg == "--sweep" && hasValue) {
+            options.sweep.push_back(argv[++i]);
+        } else if (arg == "--bench-out" && hasValue) {
+            options.benchmarkOutput = argv[++i];
+        } else if (arg == "--stats-csv" && hasValue) {
+            options.statsOutput = argv[++i];
+        } else if (arg == "--trace-out" && hasValue) {
+            options.traceOutput = argv[++i];
+        } else if (arg == "--warmup" && hasValue) {
+            if (!parseUnsigned(argv[++i], options.warmupFrames)) {
+                std::cerr << "Invalid warmup frame count: " << argv[i] << '\n';
+                return false;
+            }
+        } else if (arg == "--texture-budget" && hasValue) {
+            // megabytes, the staging buffer is this big so an absurd value is rejected rather than allocated
+            double megabytes = std::strtod(argv[++i], nullptr);
+            if (!(megabytes > 0.0 && megabytes <= 1024.0)) {
+                std::cerr << "Invalid texture budget (MB, above 0 and up to 1024): " << argv[i] << '\n';
+                return false;
+            }
+            options.textureBudget = std::max<size_t>((size_t)(megabytes * (1 << 20)), 1);
+        } else if (arg == "--frames" && hasValue) {
+            if (!parseUnsigned(argv[++i], options.measureFrames)) {
+                std::cerr << "Invalid frame count: " << argv[i] << '\n';
+                return false;
+            }
+        } else if (arg == "--culling" && hasValue) {
+            if (!parseCullMode(argv[++i], options.culling)) {
+                std::cerr << "Unknown culling mode: " << argv[i] << '\n';
+                return false;
+            }
+        } else if (arg == "--extent" && hasValue) {
+            options.scene.extent = std::strtof(argv[++i], nullptr);
+        } else if (arg.compare(0, 2, "--") == 0 && hasValue && isSceneParameter(arg.substr(2))) {
+            unsigned int value = 0;
+            if (!parseUnsigned(argv[++i], value)) {
+                std::cerr << "Invalid value for " << arg << ": " << argv[i] << '\n';
+                return false;
+            }
+            applySceneParameter(options.scene, arg.substr(2), value);
+        } else {
+            std::cerr << "Unknown argument: " << arg << '\n';
+            return false;
+        }
+    }
+    return true;
+}
+
+};
+
+#endif //PROJECT_BASE_SCENEGENERATOR_H
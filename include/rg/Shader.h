@@ -12,18 +12,32 @@
 #include <sstream>
 #include <rg/Error.h>
 #include <common.h>
+#include <rg/Profiler.h>
+#include <rg/RenderStats.h>
+#include <rg/ShaderCache.h>
+#include <rg/ShaderSources.h>
 #include <glm/glm.hpp>
 class Shader {
     unsigned int m_Id;
 public:
     Shader(std::string vertexShaderPath, std::string fragmentShaderPath) {
+        PROFILE_ZONE("Shader::Shader");
         appendShaderFolderIfNotPresent(vertexShaderPath);
         appendShaderFolderIfNotPresent(fragmentShaderPath);
         // build and compile our shader program
         // ------------------------------------
         // vertex shader
-        std::string vsString = readFileContents(vertexShaderPath);
+        rg::ShaderSource vertexSource, fragmentSource;
+        rg::ShaderSources::read(vertexShaderPath, vertexSource);
+        rg::ShaderSources::read(fragmentShaderPath, fragmentSource);
+        const std::string& vsString = vertexSource.text;
         ASSERT(!vsString.empty(), "Vertex shader source is empty!");
+        const std::string& fsString = fragmentSource.text;
+        ASSERT(!fsString.empty(), "Fragment shader empty!");
+        uint64_t cacheKey = rg::ProgramBinaryCache::key({vertexSource.hash, fragmentSource.hash});
+        m_Id = rg::ProgramBinaryCache::load(cacheKey);
+        if (m_Id != 0)
+            return;
         const char* vertexShaderSource = vsString.c_str();
         int vertexShader = glCreateShader(GL_VERTEX_SHADER);
         glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
@@ -39,8 +53,6 @@ public:
         }
         // fragment shader
         int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-        std::string fsString = readFileContents(fragmentShaderPath);
-        ASSERT(!fsString.empty(), "Fragment shader empty!");
         const char* fragmentShaderSource = fsString.c_str();
         glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
         glCompileShader(fragmentShader);
@@ -55,12 +67,15 @@ public:
         int shaderProgram = glCreateProgram();
         glAttachShader(shaderProgram, vertexShader);
         glAttachShader(shaderProgram, fragmentShader);
+        rg::ProgramBinaryCache::prepare(shaderProgram);
         glLinkProgram(shaderProgram);
         // check for linking errors
         glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
         if (!success) {
             glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
             std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+        } else {
+            rg::ProgramBinaryCache::store(cacheKey, shaderProgram);
         }
         glDeleteShader(vertexShader);
         glDeleteShader(fragmentShader);
@@ -71,65 +86,65 @@ public:
     // ------------------------------------------------------------------------
     void use()
     {
-        glUseProgram(m_Id);
+        rg::gl::UseProgram(m_Id);
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
+    void setBool(const char *name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(m_Id, name.c_str()), (int)value);
+        rg::gl::Uniform1i(glGetUniformLocation(m_Id, name), (int)value);
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
+    void setInt(const char *name, int value) const
     {
-        glUniform1i(glGetUniformLocation(m_Id, name.c_str()), value);
+        rg::gl::Uniform1i(glGetUniformLocation(m_Id, name), value);
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
+    void setFloat(const char *name, float value) const
     {
-        glUniform1f(glGetUniformLocation(m_Id, name.c_str()), value);
+        rg::gl::Uniform1f(glGetUniformLocation(m_Id, name), value);
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
+    void setVec2(const char *name, const glm::vec2 &value) const
     {
-        glUniform2fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        rg::gl::Uniform2fv(glGetUniformLocation(m_Id, name), 1, &value[0]);
     }
-    void setVec2(const std::string &name, float x, float y) const
+    void setVec2(const char *name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(m_Id, name.c_str()), x, y);
+        rg::gl::Uniform2f(glGetUniformLocation(m_Id, name), x, y);
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
+    void setVec3(const char *name, const glm::vec3 &value) const
     {
-        glUniform3fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        rg::gl::Uniform3fv(glGetUniformLocation(m_Id, name), 1, &value[0]);
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
+    void setVec3(const char *name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(m_Id, name.c_str()), x, y, z);
+        rg::gl::Uniform3f(glGetUniformLocation(m_Id, name), x, y, z);
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
+    void setVec4(const char *name, const glm::vec4 &value) const
     {
-        glUniform4fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        rg::gl::Uniform4fv(glGetUniformLocation(m_Id, name), 1, &value[0]);
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w)
+    void setVec4(const char *name, float x, float y, float z, float w)
     {
-        glUniform4f(glGetUniformLocation(m_Id, name.c_str()), x, y, z, w);
+        rg::gl::Uniform4f(glGetUniformLocation(m_Id, name), x, y, z, w);
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    void setMat2(const char *name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        rg::gl::UniformMatrix2fv(glGetUniformLocation(m_Id, name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    void setMat3(const char *name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        rg::gl::UniformMatrix3fv(glGetUniformLocation(m_Id, name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    void setMat4(const char *name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        rg::gl::UniformMatrix4fv(glGetUniformLocation(m_Id, name), 1, GL_FALSE, &mat[0][0]);
     }
     void deleteProgram() {
         glDeleteProgram(m_Id);
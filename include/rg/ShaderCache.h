@@ -0,0 +1,207 @@
+#ifndef PROJECT_BASE_SHADERCACHE_H
+#define PROJECT_BASE_SHADERCACHE_H
+
+#include <glad/glad.h>
+#include <rg/GlExtensions.h>
+#include <rg/Profiler.h>
+#include <learnopengl/filesystem.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+namespace rg {
+
+inline uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325ull) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+inline uint64_t fnv1a(const std::string& text, uint64_t hash = 0xcbf29ce484222325ull) {
+    // the terminating zero separates consecutive strings, "ab"+"c" and "a"+"bc" hash differently
+    return fnv1a(text.c_str(), text.size() + 1, hash);
+}
+
+// mkdir -p, false when a directory of the path can't be created
+inline bool createDirectories(const std::string& path) {
+    for (size_t pos = 1; pos <= path.size(); ++pos) {
+        if (pos != path.size() && path[pos] != '/')
+            continue;
+        std::string prefix = path.substr(0, pos);
+        if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST)
+            return false;
+    }
+    return true;
+}
+
+// bytes between the read position and the end of the stream, 0 when it can't be told
+inline uint64_t remainingBytes(std::istream& in) {
+    std::streampos position = in.tellg();
+    if (position < 0)
+        return 0;
+    in.seekg(0, std::ios::end);
+    std::streampos end = in.tellg();
+    in.seekg(position);
+    return end > position ? (uint64_t)(end - position) : 0;
+}
+
+// Caches linked programs with glGetProgramBinary/glProgramBinary. Entries are keyed by the
+// program sources, the defines they were built with and the driver that produced the binary,
+// so a driver update or an edited shader simply misses. A binary the driver refuses is
+// deleted and the caller compiles from source.
+//
+// Files go to <root>/cache/shaders, RG_SHADER_CACHE_DIR overrides the directory and
+// RG_SHADER_CACHE=0 turns the cache off.
+class ProgramBinaryCache {
+public:
+    static bool enabled() {
+        static bool enabled = detect();
+        return enabled;
+    }
+
+    static uint64_t key(const std::vector<std::string>& sources, const std::string& defines = "") {
+        uint64_t hash = driverKey(defines);
+        for (const std::string& source : sources)
+            hash = fnv1a(source, hash);
+        return hash;
+    }
+
+    // same, from hashes the sources already have (rg::ShaderSource::hash)
+    static uint64_t key(std::initializer_list<uint64_t> sourceHashes, const std::string& defines = "") {
+        uint64_t hash = driverKey(defines);
+        for (uint64_t sourceHash : sourceHashes)
+            hash = fnv1a(&sourceHash, sizeof(sourceHash), hash);
+        return hash;
+    }
+
+    // Has to be called before glLinkProgram for the driver to keep a retrievable binary.
+    static void prepare(GLuint program) {
+        if (enabled())
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // Returns a linked program or 0 when there is no usable binary for the key.
+    static GLuint load(uint64_t key) {
+        if (!enabled())
+            return 0;
+        PROFILE_ZONE("ProgramBinaryCache::load");
+        std::string path = entryPath(key);
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            return 0;
+
+        Header header;
+        in.read((char*)&header, sizeof(header));
+        // a length that doesn't match the file is a truncated or foreign entry
+        bool sized = in && header.length == remainingBytes(in);
+        std::vector<char> binary(sized ? header.length : 0);
+        if (!binary.empty())
+            in.read(binary.data(), binary.size());
+        if (!in || header.magic != MAGIC || header.key != key || binary.empty()) {
+            std::remove(path.c_str());
+            return 0;
+        }
+
+        GLuint program = glCreateProgram();
+        glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+        GLint success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            // e.g. the driver was updated without changing its version string
+            glDeleteProgram(program);
+            std::remove(path.c_str());
+            return 0;
+        }
+        return program;
+    }
+
+    static void store(uint64_t key, GLuint program) {
+        if (!enabled())
+            return;
+        PROFILE_ZONE("ProgramBinaryCache::store");
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+        std::vector<char> binary(length);
+        Header header;
+        header.key = key;
+        glGetProgramBinary(program, length, &length, &header.format, binary.data());
+        header.length = (uint32_t)length;
+
+        std::string path = entryPath(key);
+        std::ofstream out(path, std::ios::binary);
+        if (!out) {
+            std::cerr << "Failed to write program binary " << path << '\n';
+            return;
+        }
+        out.write((const char*)&header, sizeof(header));
+        out.write(binary.data(), length);
+    }
+
+private:
+    static uint64_t driverKey(const std::string& defines) {
+        const GlInfo& info = glInfo();
+        uint64_t hash = fnv1a(info.vendor);
+        hash = fnv1a(info.renderer, hash);
+        hash = fnv1a(info.version, hash);
+        return fnv1a(defines, hash);
+    }
+
+    static const uint32_t MAGIC = 0x42504752; // "RGPB"
+
+    struct Header {
+        uint32_t magic = MAGIC;
+        GLenum format = 0;
+        uint64_t key = 0;
+        uint32_t length = 0;
+    };
+
+    static bool detect() {
+        const char* setting = std::getenv("RG_SHADER_CACHE");
+        if (setting && std::string(setting) == "0")
+            return false;
+        if (!glInfo().atLeast(4, 1) && !glInfo().has("GL_ARB_get_program_binary"))
+            return false;
+        if (!glGetProgramBinary || !glProgramBinary || !glProgramParameteri)
+            return false;
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        if (formats <= 0)
+            return false;
+        if (!createDirectories(directory())) {
+            std::cerr << "Program binary cache disabled, cannot create " << directory() << '\n';
+            return false;
+        }
+        return true;
+    }
+
+    static const std::string& directory() {
+        static std::string dir = []() {
+            const char* env = std::getenv("RG_SHADER_CACHE_DIR");
+            return env ? std::string(env) : FileSystem::getPath("cache/shaders");
+        }();
+        return dir;
+    }
+
+    static std::string entryPath(uint64_t key) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)key);
+        return directory() + name;
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_SHADERCACHE_H
@@ -0,0 +1,186 @@
+#ifndef PROJECT_BASE_SHADERLIBRARY_H
+#define PROJECT_BASE_SHADERLIBRARY_H
+
+#include <glad/glad.h>
+#include <learnopengl/shader.h>
+#include <rg/GlExtensions.h>
+#include <rg/Profiler.h>
+#include <rg/ShaderSources.h>
+#include <rg/SpirvModules.h>
+#include <rg/ShaderWatcher.h>
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// Owns the programs of the renderer. add() only submits the compile and link, the driver works
+// on every program at once (on its own threads with KHR_parallel_shader_compile) and a program's
+// status is checked when it is first used, so startup waits for the slowest shader instead of
+// the sum of all of them.
+//
+// With watch() the library also hot reloads: an edited file is compiled again in the background
+// and the old program keeps rendering until the new one links, then update() swaps it in at the
+// start of a frame. A program that fails to build is dropped and the old one stays.
+class ShaderLibrary {
+public:
+    ShaderLibrary() {
+        if (glInfo().parallelShaderCompile)
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF); // as many threads as the driver wants
+    }
+
+    ShaderLibrary(const ShaderLibrary&) = delete;
+    ShaderLibrary& operator=(const ShaderLibrary&) = delete;
+
+    // has to run while the context is still current
+    void destroy() {
+        watcher.stop();
+        for (Program& program : programs) {
+            glDeleteProgram(program.shader.ID);
+            if (program.replacement)
+                glDeleteProgram(program.replacement->ID);
+        }
+        programs.clear();
+        pendingCount = 0;
+        reloading = 0;
+    }
+
+    // The reference stays valid for the lifetime of the library, a reload swaps the program in place.
+    Shader& add(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr,
+                const std::string& defines = "") {
+        programs.emplace_back(Shader(Shader::Deferred(), vertexPath, fragmentPath, geometryPath, defines));
+        ++pendingCount;
+        return programs.back().shader;
+    }
+
+    // from SPIR-V modules, see rg::SpirvModules
+    Shader& addSpirv(const char* vertexPath, const char* fragmentPath, const SpirvStage& vertex,
+                     const SpirvStage& fragment, const std::string& defines) {
+        programs.emplace_back(Shader(Shader::Spirv(), vertexPath, fragmentPath, vertex, fragment, defines));
+        ++pendingCount;
+        return programs.back().shader;
+    }
+
+    Shader& addCompute(const char* computePath, const std::string& defines = "") {
+        programs.emplace_back(Shader(Shader::Compute(), computePath, defines));
+        ++pendingCount;
+        return programs.back().shader;
+    }
+
+    // Sets the uniforms that are only set once (sampler units, ...). Runs now and again after
+    // every reload of the program, since a new program starts with default uniforms.
+    void setInitializer(Shader& shader, std::function<void(Shader&)> initialize) {
+        for (Program& program : programs) {
+            if (&program.shader == &shader) {
+                program.initialize = std::move(initialize);
+                program.initialize(shader);
+                return;
+            }
+        }
+    }
+
+    bool watch(const std::string& directory) {
+        return watcher.start(directory);
+    }
+
+    // Called once per frame before anything is drawn.
+    void update() {
+        if (watcher.takeChanged(changedFiles))
+            reload(changedFiles);
+        if (reloading != 0)
+            swapReloaded();
+        pollCompletion();
+    }
+
+    // Builds every program that uses one of the files again, see watch().
+    void reload(const std::vector<std::string>& fileNames) {
+        PROFILE_ZONE("ShaderLibrary::reload");
+        for (const std::string& fileName : fileNames)
+            ShaderSources::markChanged(fileName);
+        for (Program& program : programs) {
+            bool affected = false;
+            for (const std::string& fileName : fileNames)
+                affected = affected || program.shader.usesFile(fileName);
+            if (!affected)
+                continue;
+            if (program.replacement)
+                glDeleteProgram(program.replacement->ID);
+            else
+                ++reloading;
+            program.replacement.reset(new Shader(program.shader.rebuild()));
+        }
+    }
+
+    // Checks the programs the driver has finished without waiting for the others, meant to be
+    // called once per frame. Returns how many are still compiling.
+    unsigned pollCompletion() {
+        if (pendingCount == 0)
+            return 0;
+        PROFILE_ZONE("ShaderLibrary::pollCompletion");
+        unsigned stillPending = 0;
+        for (Program& program : programs) {
+            Shader& shader = program.shader;
+            if (shader.ready())
+                shader.finishLink();
+            else
+                ++stillPending;
+        }
+        pendingCount = stillPending;
+        return stillPending;
+    }
+
+    // Waits for every program, returns false if any of them failed to compile or link.
+    bool finishAll() {
+        PROFILE_ZONE("ShaderLibrary::finishAll");
+        bool ok = true;
+        for (Program& program : programs)
+            ok = program.shader.finishLink() && ok;
+        pendingCount = 0;
+        return ok;
+    }
+
+    unsigned pending() const { return pendingCount; }
+    size_t size() const { return programs.size(); }
+
+private:
+    struct Program {
+        explicit Program(Shader shader) : shader(std::move(shader)) {}
+        Shader shader;
+        std::function<void(Shader&)> initialize;
+        // the reloaded program while the driver is still building it
+        std::unique_ptr<Shader> replacement;
+    };
+
+    void swapReloaded() {
+        for (Program& program : programs) {
+            if (!program.replacement || !program.replacement->ready())
+                continue;
+            --reloading;
+            std::unique_ptr<Shader> fresh = std::move(program.replacement);
+            if (!fresh->finishLink()) {
+                std::cerr << "Reload failed, keeping the previous program\n";
+                glDeleteProgram(fresh->ID);
+                continue;
+            }
+            glDeleteProgram(program.shader.ID);
+            program.shader = std::move(*fresh);
+            if (program.initialize)
+                program.initialize(program.shader);
+            std::cerr << "Reloaded shader program " << program.shader.ID << '\n';
+        }
+    }
+
+    // deque keeps the returned references valid while programs are added
+    std::deque<Program> programs;
+    unsigned pendingCount = 0;
+    unsigned reloading = 0;
+    ShaderWatcher watcher;
+    std::vector<std::string> changedFiles;
+};
+
+};
+
+#endif //PROJECT_BASE_SHADERLIBRARY_H
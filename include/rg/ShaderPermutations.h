@@ -0,0 +1,162 @@
+#ifndef PROJECT_BASE_SHADERPERMUTATIONS_H
+#define PROJECT_BASE_SHADERPERMUTATIONS_H
+
+#include <learnopengl/shader.h>
+#include <rg/Profiler.h>
+#include <rg/ShaderLibrary.h>
+#include <rg/SpirvModules.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+namespace rg {
+
+// Features that are compiled into a shader variant instead of being branched on at runtime.
+enum ShaderFeature : uint32_t {
+    SHADER_GAMMA = 1 << 0,
+    SHADER_SPECULAR_MAP = 1 << 1,
+    SHADER_NORMAL_MAP = 1 << 2,
+    SHADER_FOG = 1 << 3,
+    // the model matrix is a per-draw instanced attribute instead of a uniform
+    SHADER_MULTI_DRAW = 1 << 4,
+};
+
+// constant_id of each feature and light count in lights.vs/fs, for the variants loaded from SPIR-V
+enum ShaderSpecialization : GLuint {
+    SPEC_GAMMA = 0,
+    SPEC_SPECULAR_MAP = 1,
+    SPEC_NORMAL_MAP = 2,
+    SPEC_FOG = 3,
+    SPEC_MULTI_DRAW = 4,
+    SPEC_DIR_LIGHTS = 5,
+    SPEC_POINT_LIGHTS = 6,
+    SPEC_SPOT_LIGHTS = 7,
+};
+
+struct ShaderVariant {
+    uint32_t features = 0;
+    unsigned dirLights = 1;
+    unsigned pointLights = 0;
+    unsigned spotLights = 1;
+
+    uint64_t key() const {
+        return (uint64_t)features | (uint64_t)(dirLights & 0xFF) << 32 | (uint64_t)(pointLights & 0xFF) << 40
+               | (uint64_t)(spotLights & 0xFF) << 48;
+    }
+
+    // every feature is defined, to 0 or 1
+    std::string defines() const {
+        std::string text;
+        text += flag("GAMMA", SHADER_GAMMA);
+        text += flag("HAS_SPECULAR_MAP", SHADER_SPECULAR_MAP);
+        text += flag("HAS_NORMAL_MAP", SHADER_NORMAL_MAP);
+        text += flag("FOG", SHADER_FOG);
+        text += flag("MULTI_DRAW", SHADER_MULTI_DRAW);
+        text += "#define NR_DIR_LIGHTS " + std::to_string(dirLights) + "\n";
+        text += "#define NR_POINT_LIGHTS " + std::to_string(pointLights) + "\n";
+        text += "#define NR_SPOT_LIGHTS " + std::to_string(spotLights) + "\n";
+        return text;
+    }
+
+    // the constants each stage declares, glSpecializeShader fails on ids a module doesn't have
+    Specialization vertexConstants() const {
+        Specialization constants;
+        constants.set(SPEC_NORMAL_MAP, (features & SHADER_NORMAL_MAP) != 0);
+        constants.set(SPEC_MULTI_DRAW, (features & SHADER_MULTI_DRAW) != 0);
+        return constants;
+    }
+
+    Specialization fragmentConstants() const {
+        Specialization constants;
+        constants.set(SPEC_GAMMA, (features & SHADER_GAMMA) != 0);
+        constants.set(SPEC_SPECULAR_MAP, (features & SHADER_SPECULAR_MAP) != 0);
+        constants.set(SPEC_NORMAL_MAP, (features & SHADER_NORMAL_MAP) != 0);
+        constants.set(SPEC_FOG, (features & SHADER_FOG) != 0);
+        constants.set(SPEC_DIR_LIGHTS, dirLights);
+        constants.set(SPEC_POINT_LIGHTS, pointLights);
+        constants.set(SPEC_SPOT_LIGHTS, spotLights);
+        return constants;
+    }
+
+private:
+    std::string flag(const char* name, ShaderFeature feature) const {
+        return std::string("#define ") + name + ((features & feature) ? " 1\n" : " 0\n");
+    }
+};
+
+// Variants of one vertex/fragment pair, compiled through the ShaderLibrary the first time they
+// are asked for. With rg::SpirvModules every variant specializes the same two modules, otherwise
+// each one compiles the GLSL with its defines. Uniforms live in the program object, so the per frame ones (camera, lights)
+// are uploaded by setupFrame when a variant is bound for the first time in a frame.
+class ShaderPermutations {
+public:
+    std::function<void(Shader&)> setupFrame;
+
+    ShaderPermutations(ShaderLibrary& library, std::string vertexPath, std::string fragmentPath)
+    : library(library), vertexPath(std::move(vertexPath)), fragmentPath(std::move(fragmentPath)) {}
+
+    Shader& get(const ShaderVariant& variant) {
+        auto it = variants.find(variant.key());
+        if (it != variants.end())
+            return *it->second.shader;
+        PROFILE_ZONE("ShaderPermutations::compile");
+        SpirvStage vertex, fragment;
+        bool spirv = SpirvModules::read(vertexPath, vertex) && SpirvModules::read(fragmentPath, fragment);
+        Shader* shader;
+        if (spirv) {
+            vertex.constants = variant.vertexConstants();
+            fragment.constants = variant.fragmentConstants();
+            shader = &library.addSpirv(vertexPath.c_str(), fragmentPath.c_str(), vertex, fragment, variant.defines());
+        } else {
+            shader = &library.add(vertexPath.c_str(), fragmentPath.c_str(), nullptr, variant.defines());
+        }
+        variants.emplace(variant.key(), Entry{shader, 0});
+        return *shader;
+    }
+
+    // Makes the variant current, switching programs only when it differs from the bound one.
+    Shader& bind(const ShaderVariant& variant) {
+        uint64_t key = variant.key();
+        if (bound && boundKey == key)
+            return *bound;
+        get(variant);
+        Entry& entry = variants[key];
+        entry.shader->use();
+        if (entry.frame != frame) {
+            entry.frame = frame;
+            if (setupFrame)
+                setupFrame(*entry.shader);
+        }
+        bound = entry.shader;
+        boundKey = key;
+        return *bound;
+    }
+
+    // Per frame uniforms are uploaded again on the next bind, other passes may have changed the program.
+    void beginFrame() {
+        ++frame;
+        bound = nullptr;
+    }
+
+    size_t size() const { return variants.size(); }
+
+private:
+    struct Entry {
+        Shader* shader;
+        uint64_t frame;
+    };
+
+    ShaderLibrary& library;
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::unordered_map<uint64_t, Entry> variants;
+    Shader* bound = nullptr;
+    uint64_t boundKey = 0;
+    uint64_t frame = 1;
+};
+
+};
+
+#endif //PROJECT_BASE_SHADERPERMUTATIONS_H
@@ -0,0 +1,115 @@
+#ifndef PROJECT_BASE_SHADERSOURCES_H
+#define PROJECT_BASE_SHADERSOURCES_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+
+namespace rg {
+
+// FNV-1a, constexpr so the embedded shaders are hashed by the compiler.
+constexpr uint64_t hashSource(const char* text, size_t size) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= (unsigned char)text[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+struct EmbeddedShader {
+    const char* path;
+    const char* source;
+    size_t size;
+    uint64_t hash;
+};
+
+};
+
+#ifdef RG_EMBED_SHADERS
+// generated into the build directory from resources/shaders by cmake/EmbedShaders.cmake
+#include <rg/EmbeddedShaderData.h>
+#endif
+
+namespace rg {
+
+struct ShaderSource {
+    std::string text;
+    uint64_t hash = 0;
+};
+
+// Shader sources compiled into the executable. Files are read from disk when the build doesn't
+// embed them, when a path isn't embedded, when RG_SHADERS_FROM_DISK=1 is set for editing
+// shaders without rebuilding, or once hot reload saw the file change.
+class ShaderSources {
+public:
+    static bool fromDisk() {
+        static bool disk = []() {
+            const char* setting = std::getenv("RG_SHADERS_FROM_DISK");
+            return setting && std::string(setting) != "0";
+        }();
+        return disk;
+    }
+
+    // the embedded copy of the file is stale from now on
+    static void markChanged(const std::string& fileName) {
+        changedFiles().insert(fileName);
+    }
+
+    // hot reload saw the file change, what was built from it before the run (embedded copy,
+    // SPIR-V module) is stale
+    static bool edited(const std::string& path) {
+        return changed(path.c_str());
+    }
+
+    static bool read(const std::string& path, ShaderSource& out) {
+#ifdef RG_EMBED_SHADERS
+        if (!fromDisk()) {
+            for (const EmbeddedShader& shader : embedded::shaders) {
+                if (matches(path, shader.path) && !changed(shader.path)) {
+                    out.text.assign(shader.source, shader.size);
+                    out.hash = shader.hash;
+                    return true;
+                }
+            }
+        }
+#endif
+        std::ifstream in(path);
+        if (!in)
+            return false;
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        out.text = buffer.str();
+        out.hash = hashSource(out.text.data(), out.text.size());
+        return true;
+    }
+
+private:
+    static std::set<std::string>& changedFiles() {
+        static std::set<std::string> files;
+        return files;
+    }
+
+    static bool changed(const char* embeddedPath) {
+        if (changedFiles().empty())
+            return false;
+        const char* fileName = std::strrchr(embeddedPath, '/');
+        return changedFiles().count(fileName ? fileName + 1 : embeddedPath) != 0;
+    }
+
+    // embedded paths are relative to the project root, callers may pass absolute ones
+    static bool matches(const std::string& path, const char* embeddedPath) {
+        size_t length = std::strlen(embeddedPath);
+        if (path.size() < length || path.compare(path.size() - length, length, embeddedPath) != 0)
+            return false;
+        return path.size() == length || path[path.size() - length - 1] == '/';
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_SHADERSOURCES_H
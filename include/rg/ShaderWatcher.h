@@ -0,0 +1,114 @@
+#ifndef PROJECT_BASE_SHADERWATCHER_H
+#define PROJECT_BASE_SHADERWATCHER_H
+
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace rg {
+
+// Watches a directory with inotify on a background thread and collects the names of the files
+// written to it. The render thread picks them up with takeChanged(), which doesn't lock or
+// allocate while nothing changed. Other platforms get a watcher that never reports anything.
+class ShaderWatcher {
+public:
+    ShaderWatcher() = default;
+    ShaderWatcher(const ShaderWatcher&) = delete;
+    ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+    ~ShaderWatcher() { stop(); }
+
+    bool start(const std::string& directory) {
+#ifdef __linux__
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0) {
+            std::cerr << "Shader hot reload disabled, inotify_init1 failed\n";
+            return false;
+        }
+        // editors either write the file in place or rename a temporary over it
+        if (inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            std::cerr << "Shader hot reload disabled, cannot watch " << directory << '\n';
+            close(fd);
+            fd = -1;
+            return false;
+        }
+        running = true;
+        worker = std::thread([this]() { watch(); });
+        return true;
+#else
+        std::cerr << "Shader hot reload is only available on Linux\n";
+        return false;
+#endif
+    }
+
+    void stop() {
+        if (!running)
+            return;
+        running = false;
+        worker.join();
+#ifdef __linux__
+        close(fd);
+        fd = -1;
+#endif
+    }
+
+    // Moves the names of the files changed since the last call into out (cleared first).
+    bool takeChanged(std::vector<std::string>& out) {
+        out.clear();
+        if (!hasChanges.load(std::memory_order_acquire))
+            return false;
+        std::lock_guard<std::mutex> lock(mutex);
+        out.swap(changed);
+        hasChanges.store(false, std::memory_order_release);
+        return !out.empty();
+    }
+
+private:
+    std::thread worker;
+    std::atomic<bool> running{false};
+    std::atomic<bool> hasChanges{false};
+    std::mutex mutex;
+    std::vector<std::string> changed;
+    int fd = -1;
+
+#ifdef __linux__
+    void watch() {
+        alignas(inotify_event) char buffer[4096];
+        while (running) {
+            // wakes up regularly so stop() doesn't wait for the next file change
+            pollfd descriptor{fd, POLLIN, 0};
+            if (poll(&descriptor, 1, 100) <= 0)
+                continue;
+            ssize_t length = read(fd, buffer, sizeof(buffer));
+            for (ssize_t offset = 0; offset < length;) {
+                const inotify_event* event = (const inotify_event*)(buffer + offset);
+                if (event->len > 0)
+                    add(event->name);
+                offset += sizeof(inotify_event) + event->len;
+            }
+        }
+    }
+
+    void add(const char* fileName) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const std::string& name : changed)
+            if (name == fileName)
+                return;
+        changed.emplace_back(fileName);
+        hasChanges.store(true, std::memory_order_release);
+    }
+#endif
+};
+
+};
+
+#endif //PROJECT_BASE_SHADERWATCHER_H
@@ -0,0 +1,95 @@
+#ifndef PROJECT_BASE_SPIRVMODULES_H
+#define PROJECT_BASE_SPIRVMODULES_H
+
+#include <glad/glad.h>
+#include <rg/GlExtensions.h>
+#include <rg/Profiler.h>
+#include <rg/ShaderCache.h>
+#include <rg/ShaderSources.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// values of a module's specialization constants, by constant_id
+struct Specialization {
+    std::vector<GLuint> indices;
+    std::vector<GLuint> values;
+
+    void set(GLuint index, GLuint value) {
+        indices.push_back(index);
+        values.push_back(value);
+    }
+};
+
+// one stage of a program loaded from SPIR-V
+struct SpirvStage {
+    std::vector<char> module;
+    uint64_t hash = 0;
+    Specialization constants;
+};
+
+// Shaders compiled to SPIR-V and validated at build time by cmake/SpirvShaders.cmake, loaded
+// with glShaderBinary and glSpecializeShader instead of going through the driver's GLSL front-end.
+// Only shaders written for it can be loaded this way: a SPIR-V program has no uniform names, so
+// the shader gives every default block uniform a location and every block a binding, and its
+// variants are specialization constants instead of defines. The lit shaders
+// (rg::ShaderPermutations) are; the others, and every program on a context without
+// rg::glInfo().spirv, compile the GLSL.
+//
+// The modules are read from RG_SPIRV_DIR, set by the build when glslang is found. RG_SPIRV=0
+// turns them off, and a file changed by hot reload is compiled from GLSL from then on.
+class SpirvModules {
+public:
+    static bool enabled() {
+#ifdef RG_SPIRV_DIR
+        static bool enabled = []() {
+            const char* setting = std::getenv("RG_SPIRV");
+            return !(setting && std::string(setting) == "0");
+        }();
+        return enabled && glInfo().spirv;
+#else
+        return false;
+#endif
+    }
+
+    // the module built from the shader at path, false when there is none or it is stale
+    static bool read(const std::string& path, SpirvStage& stage) {
+#ifdef RG_SPIRV_DIR
+        if (!enabled() || ShaderSources::edited(path))
+            return false;
+        size_t slash = path.find_last_of('/');
+        std::ifstream in(std::string(RG_SPIRV_DIR) + "/" + path.substr(slash == std::string::npos ? 0 : slash + 1) + ".spv",
+                         std::ios::binary);
+        if (!in)
+            return false;
+        stage.module.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        // a SPIR-V module is a whole number of 32 bit words
+        if (stage.module.empty() || stage.module.size() % 4 != 0)
+            return false;
+        stage.hash = fnv1a(stage.module.data(), stage.module.size());
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // errors show in GL_COMPILE_STATUS like a GLSL compile's
+    static GLuint compileStage(GLenum type, const SpirvStage& stage) {
+        PROFILE_ZONE("SpirvModules::compileStage");
+        GLuint shader = glCreateShader(type);
+        glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V, stage.module.data(), (GLsizei)stage.module.size());
+        glSpecializeShader(shader, "main", (GLuint)stage.constants.indices.size(), stage.constants.indices.data(),
+                           stage.constants.values.data());
+        return shader;
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_SPIRVMODULES_H
@@ -0,0 +1,128 @@
+#ifndef PROJECT_BASE_STATICBATCH_H
+#define PROJECT_BASE_STATICBATCH_H
+
+#include <glm/glm.hpp>
+#include <learnopengl/mesh.h>
+#include <learnopengl/model.h>
+#include <rg/Culling.h>
+#include <rg/Meshlets.h>
+#include <rg/Profiler.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <tuple>
+#include <vector>
+
+namespace rg {
+
+// Merges the copies of meshes that never move into a few big meshes. The world transform of
+// every copy is baked into its vertices, and the copies with the same material in the same cell
+// of a grid share one mesh. The static scenery then costs one draw per material and cell
+// instead of one per object and mesh. The cells keep the merged meshes local enough for frustum
+// culling, and the meshlets of the copies come along for cluster culling.
+//
+// The source meshes have to keep their vertices (Model's retainGeometry) and outlive the batch,
+// which draws their full detail level with their textures.
+class StaticBatch {
+public:
+    explicit StaticBatch(float cellSize = 8.0f) : cellSize(cellSize) {}
+
+    void clear() {
+        copies.clear();
+        meshes.clear();
+    }
+
+    void add(const Mesh& mesh, const glm::mat4& transform) {
+        copies.push_back(Copy{&mesh, transform, Key()});
+    }
+
+    void add(const Model& model, const glm::mat4& transform) {
+        for (const Mesh& mesh : model.meshes)
+            add(mesh, transform);
+    }
+
+    // replaces the merged meshes with the copies added since clear()
+    void build(MeshGeometryPool& pool) {
+        PROFILE_ZONE("StaticBatch::build");
+        meshes.clear();
+        for (Copy& copy : copies) {
+            glm::vec3 center = glm::vec3(transformSphere(copy.transform, copy.mesh->bounds));
+            copy.key = Key(copy.mesh->materialKey, (int)std::floor(center.x / cellSize),
+                           (int)std::floor(center.y / cellSize), (int)std::floor(center.z / cellSize));
+        }
+        // submission order inside a batch, so equal scenes build equal batches
+        std::stable_sort(copies.begin(), copies.end(), [](const Copy& a, const Copy& b) { return a.key < b.key; });
+
+        for (size_t first = 0; first < copies.size();) {
+            size_t end = first + 1;
+            while (end < copies.size() && copies[end].key == copies[first].key)
+                ++end;
+            merge(pool, first, end);
+            first = end;
+        }
+    }
+
+    // the merged meshes are in world space
+    void Queue(MeshDrawList& list, bool clusters = false) const {
+        for (const Mesh& mesh : meshes)
+            mesh.Queue(list, glm::mat4(1.0f), 0, clusters);
+    }
+
+    const std::vector<Mesh>& batches() const { return meshes; }
+    // mesh copies merged into the batches, each would have been a draw of its own
+    size_t copyCount() const { return copies.size(); }
+
+private:
+    // material and grid cell
+    using Key = std::tuple<uint64_t, int, int, int>;
+
+    struct Copy {
+        const Mesh* mesh;
+        glm::mat4 transform;
+        Key key;
+    };
+
+    void merge(MeshGeometryPool& pool, size_t first, size_t end) {
+        vector<Vertex> vertices;
+        vector<unsigned int> indices;
+        vector<Meshlet> meshlets;
+        for (size_t i = first; i < end; ++i) {
+            const Mesh& mesh = *copies[i].mesh;
+            const glm::mat4& transform = copies[i].transform;
+            if (mesh.vertices.empty() && mesh.indexCount > 0) {
+                std::cerr << "StaticBatch: a mesh without retained geometry was skipped\n";
+                continue;
+            }
+            uint32_t baseVertex = (uint32_t)vertices.size();
+            uint32_t firstIndex = (uint32_t)indices.size();
+            glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(transform)));
+            for (const Vertex& vertex : mesh.vertices)
+                vertices.push_back(TransformVertex(vertex, transform, normalMatrix));
+            for (unsigned int index = 0; index < mesh.indexCount; ++index)
+                indices.push_back(mesh.indices[index] + baseVertex);
+            for (uint32_t m = mesh.lodMeshlets[0]; m < mesh.lodMeshlets[1]; ++m) {
+                const Meshlet& meshlet = mesh.meshlets[m];
+                meshlets.push_back(Meshlet{meshlet.firstIndex + firstIndex, meshlet.indexCount,
+                                           transformSphere(transform, meshlet.sphere),
+                                           transformCone(transform, meshlet.cone)});
+            }
+        }
+        if (indices.empty())
+            return;
+        const Mesh& source = *copies[first].mesh;
+        vector<Texture> textures = source.textures;
+        meshes.emplace_back(pool, Mesh::Prepared{}, std::move(vertices), std::move(indices), std::move(textures),
+                            std::move(meshlets));
+        meshes.back().SetShaderTextureNamePrefix(source.glslIdentifierPrefix);
+    }
+
+    float cellSize;
+    std::vector<Copy> copies;
+    std::vector<Mesh> meshes;
+};
+
+};
+
+#endif //PROJECT_BASE_STATICBATCH_H
@@ -0,0 +1,196 @@
+#ifndef PROJECT_BASE_STREAMBUFFER_H
+#define PROJECT_BASE_STREAMBUFFER_H
+
+#include <glad/glad.h>
+#include <rg/GlExtensions.h>
+#include <rg/GlObjects.h>
+#include <rg/Profiler.h>
+#include <rg/RenderStats.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace rg {
+
+// frames the CPU may write ahead of the GPU
+const unsigned int STREAM_FRAMES = 3;
+
+// Ring of the data the CPU writes every frame and the GPU reads once: uniform blocks, instance
+// records, indirect commands, vertices transformed on the CPU. One buffer serves every target, it
+// has a region per frame in flight. With rg::glInfo().bufferStorage it is mapped once,
+// persistently and coherently: allocations point straight into memory the GPU reads, nothing is
+// copied by the driver, and a fence per region keeps the CPU from overwriting a region before the
+// GPU is done with it. The CPU runs up to frames - 1 frames ahead and only waits when it gets
+// further. Without buffer storage the allocations go to a CPU copy, flush() uploads what was
+// written since the last flush and the buffer is orphaned every frame.
+//
+// A frame that runs out of room replaces the buffer with one twice the size. The old one is
+// deleted in the next beginFrame(), so what was allocated from it earlier in the frame can still
+// be bound, and the GL keeps it alive for the draws reading it. Vertex arrays compare
+// generation() with the one they were set up for, a new buffer may reuse an old name.
+class StreamBuffer {
+public:
+    struct Allocation {
+        char* data;
+        // bytes into buffer()
+        GLintptr offset;
+    };
+
+    void init(size_t frameBytes, unsigned int frames = STREAM_FRAMES) {
+        persistent = glInfo().bufferStorage;
+        // orphaning gives every frame storage of its own already
+        frameCount = persistent ? std::max(frames, 1u) : 1;
+        region = 0;
+        create(frameBytes);
+    }
+
+    void destroy() {
+        retired.clear();
+        release();
+        staging = std::vector<char>();
+    }
+
+    // moves to the next region, waits for the GPU if it still reads it
+    void beginFrame() {
+        retired.clear();
+        region = (region + 1) % frameCount;
+        head = flushed = region * frameBytes;
+        used = 0;
+        if (persistent) {
+            wait(fences[region]);
+        } else {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, storage.get());
+            gl::BufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)(frameBytes * frameCount), nullptr, GL_STREAM_DRAW);
+        }
+    }
+
+    // after the last draw reading this frame's allocations
+    void endFrame() {
+        flush();
+        if (persistent)
+            fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // bytes at a multiple of alignment into the buffer, which may be any size (a vertex stride so
+    // draws can start at offset / stride)
+    Allocation allocate(size_t bytes, size_t alignment = 16) {
+        reserve(bytes + alignment - 1);
+        size_t offset = roundUp(head, alignment);
+        head = offset + bytes;
+        used += bytes;
+        return Allocation{base() + offset, (GLintptr)offset};
+    }
+
+    // makes sure the next allocations of up to bytes in total, alignment padding included, land
+    // in the current buffer
+    void reserve(size_t bytes) {
+        if (head + bytes > (region + 1) * frameBytes) {
+            flush();
+            create(std::max(frameBytes * 2, bytes));
+        }
+    }
+
+    // count elements at a multiple of alignment, returns their offset
+    template <typename T>
+    GLintptr write(const T* data, size_t count, size_t alignment = alignof(T)) {
+        Allocation allocation = allocate(count * sizeof(T), alignment);
+        std::memcpy(allocation.data, data, count * sizeof(T));
+        return allocation.offset;
+    }
+
+    // makes the allocations visible to the GPU, before the draws reading them
+    void flush() {
+        if (!persistent && head > flushed) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, storage.get());
+            gl::BufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)flushed, (GLsizeiptr)(head - flushed), staging.data() + flushed);
+        }
+        flushed = head;
+    }
+
+    GLuint buffer() const { return storage.get(); }
+    // counts the buffers created, a vertex array pointing at the ring is stale when it changes
+    uint64_t generation() const { return generationCount; }
+    bool isPersistent() const { return persistent; }
+    size_t frameSize() const { return frameBytes; }
+    unsigned int framesInFlight() const { return frameCount; }
+    // bytes allocated since beginFrame()
+    size_t frameUsage() const { return used; }
+    // beginFrame() calls that had to wait for the GPU
+    uint64_t stalls() const { return stallCount; }
+
+private:
+    static size_t roundUp(size_t offset, size_t alignment) {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    char* base() { return persistent ? mapped : staging.data(); }
+
+    void create(size_t bytes) {
+        if (storage)
+            retired.push_back(GlBuffer(storage.release()));
+        release();
+        frameBytes = bytes;
+        size_t capacity = frameBytes * frameCount;
+        storage = GlBuffer::create();
+        ++generationCount;
+        // the copy target leaves the bindings of the draws alone
+        glBindBuffer(GL_COPY_WRITE_BUFFER, storage.get());
+        if (persistent) {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_COPY_WRITE_BUFFER, (GLsizeiptr)capacity, nullptr, flags);
+            mapped = (char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, (GLsizeiptr)capacity, flags);
+        } else {
+            gl::BufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)capacity, nullptr, GL_STREAM_DRAW);
+            staging.resize(capacity);
+        }
+        fences.assign(frameCount, nullptr);
+        head = flushed = region * frameBytes;
+    }
+
+    void release() {
+        for (GLsync& fence : fences) {
+            if (fence)
+                glDeleteSync(fence);
+            fence = nullptr;
+        }
+        // deleting a persistently mapped buffer unmaps it
+        storage.reset();
+        mapped = nullptr;
+    }
+
+    void wait(GLsync& fence) {
+        if (!fence)
+            return;
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            PROFILE_ZONE("StreamBuffer wait");
+            ++stallCount;
+            while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull) == GL_TIMEOUT_EXPIRED) {
+            }
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    GlBuffer storage;
+    // replaced this frame, see create()
+    std::vector<GlBuffer> retired;
+    bool persistent = false;
+    char* mapped = nullptr;
+    std::vector<char> staging;
+    std::vector<GLsync> fences;
+    unsigned int frameCount = 1;
+    unsigned int region = 0;
+    size_t frameBytes = 0;
+    size_t head = 0;
+    size_t flushed = 0;
+    size_t used = 0;
+    uint64_t generationCount = 0;
+    uint64_t stallCount = 0;
+};
+
+};
+
+#endif //PROJECT_BASE_STREAMBUFFER_H
@@ -0,0 +1,362 @@
+#ifndef PROJECT_BASE_TEXTUREUPLOADER_H
+#define PROJECT_BASE_TEXTUREUPLOADER_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+#include <rg/Profiler.h>
+#include <rg/RenderStats.h>
+#include <rg/StreamBuffer.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rg {
+
+// bytes of texels copied to textures per frame by default
+const size_t TEXTURE_UPLOAD_BUDGET = 4 << 20;
+
+// Loads textures without holding up the frame. load2D() and loadCubemap() return the texture name
+// right away, a worker thread decodes the files and update() streams the texels into the
+// textures, at most budget bytes per frame. The texels go through a StreamBuffer bound as the
+// pixel unpack buffer, so glTexSubImage2D returns once the rows are queued and the GL copies them
+// while the frame renders. A large texture takes a few frames, rows at a time.
+//
+// Until its texels are in, a texture samples a grey placeholder: the smallest mipmap level holds
+// it and is the only level the texture uses. The last rows move the base level back to 0 and
+// generate the mipmaps, and ready() turns true once a fence after them has passed.
+class TextureUploader {
+public:
+    TextureUploader() = default;
+    TextureUploader(const TextureUploader&) = delete;
+    TextureUploader& operator=(const TextureUploader&) = delete;
+
+    ~TextureUploader() { stopWorker(); }
+
+    void init(size_t budgetBytes = TEXTURE_UPLOAD_BUDGET) {
+        budget = std::max<size_t>(budgetBytes, 1);
+        // allocate() reserves alignment - 1 bytes past the rows for padding, a frame that spends the
+        // whole budget still fits
+        staging.init(budget + STAGING_ALIGNMENT);
+        running = true;
+        worker = std::thread([this]() { decode(); });
+    }
+
+    // leaves the unfinished textures as they are
+    void destroy() {
+        stopWorker();
+        for (std::deque<std::unique_ptr<Job>>* jobs : {&requests, &decoded, &uploading})
+            for (std::unique_ptr<Job>& job : *jobs)
+                job->freeImages();
+        requests.clear();
+        decoded.clear();
+        uploading.clear();
+        for (Fenced& fenced : fences)
+            glDeleteSync(fenced.fence);
+        fences.clear();
+        waiting.clear();
+        staging.destroy();
+    }
+
+    // Mipmapped, clamped to the edge when clampAlpha is set and the file has an alpha channel (for
+    // blending), repeated otherwise.
+    GLuint load2D(const std::string& path, bool gamma = false, bool clampAlpha = false) {
+        std::unique_ptr<Job> job(new Job());
+        job->target = GL_TEXTURE_2D;
+        job->paths.push_back(path);
+        job->gamma = gamma;
+        job->clampAlpha = clampAlpha;
+        return submit(std::move(job));
+    }
+
+    // faces in the order of GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, no mipmaps
+    GLuint loadCubemap(const std::vector<std::string>& faces) {
+        std::unique_ptr<Job> job(new Job());
+        job->target = GL_TEXTURE_CUBE_MAP;
+        job->paths = faces;
+        return submit(std::move(job));
+    }
+
+    // once per frame, before the draws sampling the textures
+    void update() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            while (!decoded.empty()) {
+                uploading.push_back(std::move(decoded.front()));
+                decoded.pop_front();
+            }
+        }
+        if (!uploading.empty())
+            upload();
+        poll();
+    }
+
+    // Blocks until every texture submitted so far is in, for the loads before the first frame.
+    void finish() {
+        PROFILE_ZONE("TextureUploader::finish");
+        while (!waiting.empty()) {
+            update();
+            if (!fences.empty())
+                glClientWaitSync(fences.front().fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+            else if (uploading.empty())
+                std::this_thread::yield();
+        }
+    }
+
+    bool ready(GLuint texture) const {
+        return std::find(waiting.begin(), waiting.end(), texture) == waiting.end();
+    }
+
+    // textures submitted and not ready yet
+    size_t pending() const { return waiting.size(); }
+    size_t frameBudget() const { return budget; }
+    // bytes copied in the last update() that had texels to copy
+    size_t lastUploadBytes() const { return uploadedBytes; }
+
+private:
+    // offset alignment of the rows in the staging buffer
+    static const size_t STAGING_ALIGNMENT = 4;
+
+    struct Image {
+        unsigned char* pixels = nullptr;
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+    };
+
+    struct Job {
+        GLuint texture = 0;
+        GLenum target = GL_TEXTURE_2D;
+        std::vector<std::string> paths;
+        bool gamma = false;
+        bool clampAlpha = false;
+        // one per path, filled by the worker
+        std::vector<Image> images;
+        // upload progress, owned by update()
+        bool started = false;
+        size_t face = 0;
+        int row = 0;
+
+        void freeImages() {
+            for (Image& image : images) {
+                stbi_image_free(image.pixels);
+                image.pixels = nullptr;
+            }
+        }
+    };
+
+    struct Fenced {
+        GLuint texture;
+        GLsync fence;
+    };
+
+    GLuint submit(std::unique_ptr<Job> job) {
+        glGenTextures(1, &job->texture);
+        GLuint texture = job->texture;
+        gl::BindTexture(job->target, texture);
+        const unsigned char grey[4] = {128, 128, 128, 255};
+        for (size_t face = 0; face < job->paths.size(); ++face)
+            gl::TexImage2D(faceTarget(*job, face), 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+        glTexParameteri(job->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(job->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        waiting.push_back(texture);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requests.push_back(std::move(job));
+        }
+        wake.notify_one();
+        return texture;
+    }
+
+    static GLenum faceTarget(const Job& job, size_t face) {
+        return job.target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + (GLenum)face : job.target;
+    }
+
+    static GLenum format(int channels) {
+        return channels == 1 ? GL_RED : channels == 2 ? GL_RG : channels == 3 ? GL_RGB : GL_RGBA;
+    }
+
+    static GLenum internalFormat(const Job& job, int channels) {
+        if (job.gamma && channels == 3)
+            return GL_SRGB;
+        if (job.gamma && channels == 4)
+            return GL_SRGB_ALPHA;
+        return format(channels);
+    }
+
+    void upload() {
+        PROFILE_ZONE("TextureUploader::update");
+        staging.beginFrame();
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        size_t spent = 0;
+        size_t uploaded = 0;
+        while (!uploading.empty() && spent < budget) {
+            Job& job = *uploading.front();
+            if (!job.started)
+                start(job);
+            if (job.face == job.images.size()) {
+                complete(job);
+                uploading.pop_front();
+                continue;
+            }
+            Image& image = job.images[job.face];
+            if (!image.pixels || job.row >= image.height) {
+                ++job.face;
+                job.row = 0;
+                continue;
+            }
+            // whole rows; a frame that can't fit the next one leaves it for the next frame, unless
+            // it is the first, so a row wider than the budget still moves
+            size_t rowBytes = (size_t)image.width * image.channels;
+            size_t rowsLeft = (budget - spent) / rowBytes;
+            if (rowsLeft == 0 && spent > 0)
+                break;
+            int rows = (int)std::min<size_t>(std::max<size_t>(rowsLeft, 1), (size_t)(image.height - job.row));
+            size_t bytes = rows * rowBytes;
+            StreamBuffer::Allocation allocation = staging.allocate(bytes, STAGING_ALIGNMENT);
+            std::memcpy(allocation.data, image.pixels + job.row * rowBytes, bytes);
+            staging.flush();
+
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer());
+            gl::BindTexture(job.target, job.texture);
+            gl::TexSubImage2D(faceTarget(job, job.face), 0, 0, job.row, image.width, rows, format(image.channels),
+                              GL_UNSIGNED_BYTE, (const void*)allocation.offset);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            job.row += rows;
+            // the padding before the next allocation counts against the budget too
+            spent += (bytes + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+            uploaded += bytes;
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        staging.endFrame();
+        uploadedBytes = uploaded;
+    }
+
+    // storage for the full size texels, the placeholder moves to the smallest level
+    void start(Job& job) {
+        job.started = true;
+        gl::BindTexture(job.target, job.texture);
+        const unsigned char grey[4] = {128, 128, 128, 255};
+        int placeholderLevel = 0;
+        for (size_t face = 0; face < job.images.size(); ++face) {
+            const Image& image = job.images[face];
+            if (!image.pixels) {
+                std::cout << (job.target == GL_TEXTURE_CUBE_MAP ? "Cubemap texture" : "Texture")
+                          << " failed to load at path: " << job.paths[face] << std::endl;
+                continue;
+            }
+            int level = 0;
+            while ((image.width >> (level + 1)) > 0 || (image.height >> (level + 1)) > 0)
+                ++level;
+            GLenum target = faceTarget(job, face);
+            gl::TexImage2D(target, 0, internalFormat(job, image.channels), image.width, image.height, 0,
+                           format(image.channels), GL_UNSIGNED_BYTE, nullptr);
+            if (level > 0)
+                gl::TexImage2D(target, level, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+            placeholderLevel = level;
+        }
+        glTexParameteri(job.target, GL_TEXTURE_BASE_LEVEL, placeholderLevel);
+        glTexParameteri(job.target, GL_TEXTURE_MAX_LEVEL, placeholderLevel);
+    }
+
+    void complete(Job& job) {
+        gl::BindTexture(job.target, job.texture);
+        glTexParameteri(job.target, GL_TEXTURE_BASE_LEVEL, 0);
+        if (job.target == GL_TEXTURE_CUBE_MAP) {
+            glTexParameteri(job.target, GL_TEXTURE_MAX_LEVEL, 0);
+            glTexParameteri(job.target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(job.target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(job.target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        } else if (job.images[0].pixels) {
+            glTexParameteri(job.target, GL_TEXTURE_MAX_LEVEL, 1000);
+            {
+                PROFILE_ZONE("glGenerateMipmap");
+                glGenerateMipmap(job.target);
+            }
+            GLenum wrap = job.clampAlpha && job.images[0].channels == 4 ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+            glTexParameteri(job.target, GL_TEXTURE_WRAP_S, wrap);
+            glTexParameteri(job.target, GL_TEXTURE_WRAP_T, wrap);
+            glTexParameteri(job.target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        }
+        job.freeImages();
+        fences.push_back(Fenced{job.texture, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)});
+    }
+
+    // textures whose fence passed are ready, fences pass in order
+    void poll() {
+        size_t passed = 0;
+        for (; passed < fences.size(); ++passed) {
+            Fenced& fenced = fences[passed];
+            if (glClientWaitSync(fenced.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+                break;
+            glDeleteSync(fenced.fence);
+            waiting.erase(std::find(waiting.begin(), waiting.end(), fenced.texture));
+        }
+        fences.erase(fences.begin(), fences.begin() + passed);
+    }
+
+    void decode() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this]() { return !running || !requests.empty(); });
+            if (!running)
+                return;
+            std::unique_ptr<Job> job = std::move(requests.front());
+            requests.pop_front();
+            lock.unlock();
+            {
+                PROFILE_ZONE("stbi_load");
+                job->images.resize(job->paths.size());
+                for (size_t face = 0; face < job->paths.size(); ++face) {
+                    Image& image = job->images[face];
+                    image.pixels = stbi_load(job->paths[face].c_str(), &image.width, &image.height, &image.channels, 0);
+                }
+            }
+            lock.lock();
+            decoded.push_back(std::move(job));
+        }
+    }
+
+    void stopWorker() {
+        if (!worker.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+
+    size_t budget = TEXTURE_UPLOAD_BUDGET;
+    StreamBuffer staging;
+    std::thread worker;
+    std::atomic<bool> running{false};
+    std::mutex mutex;
+    std::condition_variable wake;
+    // guarded by mutex: files to decode, decoded files waiting for update()
+    std::deque<std::unique_ptr<Job>> requests;
+    std::deque<std::unique_ptr<Job>> decoded;
+    std::deque<std::unique_ptr<Job>> uploading;
+    std::vector<Fenced> fences;
+    std::vector<GLuint> waiting;
+    size_t uploadedBytes = 0;
+};
+
+inline TextureUploader& textureUploader() {
+    static TextureUploader uploader;
+    return uploader;
+}
+
+};
+
+#endif //PROJECT_BASE_TEXTUREUPLOADER_H
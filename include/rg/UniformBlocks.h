@@ -0,0 +1,55 @@
+#ifndef PROJECT_BASE_UNIFORMBLOCKS_H
+#define PROJECT_BASE_UNIFORMBLOCKS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <rg/GlExtensions.h>
+#include <rg/StreamBuffer.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace rg {
+namespace std140 {
+
+// array element of a scalar or a vector smaller than vec4, std140 pads it to 16 bytes
+template <typename T>
+struct alignas(16) Padded {
+    T value;
+};
+
+};
+};
+
+// generated into the build directory from resources/shaders by tools/ShaderReflect.cpp
+#include <rg/ShaderBlocks.h>
+
+namespace rg {
+
+// Points every uniform block the program declares at its generated binding index. GL 3.3 has no
+// layout(binding = N), so this runs after every link and every program binary load.
+inline void bindUniformBlocks(GLuint program) {
+    for (const glsl::BlockBinding& block : glsl::blockBindings) {
+        if (!block.name)
+            continue;
+        GLuint index = glGetUniformBlockIndex(program, block.name);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(program, index, block.binding);
+    }
+}
+
+// Writes the first bytes of a generated block (rg::glsl::*, all of it by default) to the frame's
+// ring and binds them to the block's binding index for the rest of the frame. The layout is
+// checked at compile time.
+template <typename Block>
+void uploadUniformBlock(StreamBuffer& ring, const Block& data, size_t bytes = sizeof(Block)) {
+    StreamBuffer::Allocation allocation = ring.allocate(sizeof(Block), (size_t)glInfo().uniformBufferAlignment);
+    std::memcpy(allocation.data, &data, bytes);
+    ring.flush();
+    glBindBufferRange(GL_UNIFORM_BUFFER, Block::binding, ring.buffer(), allocation.offset, sizeof(Block));
+}
+
+};
+
+#endif //PROJECT_BASE_UNIFORMBLOCKS_H
@@ -0,0 +1,171 @@
+#ifndef PROJECT_BASE_VERTEXLAYOUT_H
+#define PROJECT_BASE_VERTEXLAYOUT_H
+
+#include <glad/glad.h>
+#include <rg/GlExtensions.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rg {
+
+// How the shader reads an attribute: Float converts integers to float as they are, Normalized maps
+// them to [0, 1] or [-1, 1], Integer keeps them as int/uint (glVertexAttribIPointer).
+enum class AttribKind { Float, Normalized, Integer };
+
+// storage types without a C++ counterpart
+struct Half {
+    uint16_t bits;
+};
+// x, y, z in 10 bits each and w in the top 2 bits of one word, four components per attribute
+struct Int2101010 {
+    uint32_t bits;
+};
+struct UInt2101010 {
+    uint32_t bits;
+};
+
+// GL type of one component, packed types hold every component of the attribute
+template <typename T> struct GlComponent;
+template <> struct GlComponent<float> { static constexpr GLenum type = GL_FLOAT; static constexpr bool packed = false; };
+template <> struct GlComponent<Half> { static constexpr GLenum type = GL_HALF_FLOAT; static constexpr bool packed = false; };
+template <> struct GlComponent<int8_t> { static constexpr GLenum type = GL_BYTE; static constexpr bool packed = false; };
+template <> struct GlComponent<uint8_t> { static constexpr GLenum type = GL_UNSIGNED_BYTE; static constexpr bool packed = false; };
+template <> struct GlComponent<int16_t> { static constexpr GLenum type = GL_SHORT; static constexpr bool packed = false; };
+template <> struct GlComponent<uint16_t> { static constexpr GLenum type = GL_UNSIGNED_SHORT; static constexpr bool packed = false; };
+template <> struct GlComponent<int32_t> { static constexpr GLenum type = GL_INT; static constexpr bool packed = false; };
+template <> struct GlComponent<uint32_t> { static constexpr GLenum type = GL_UNSIGNED_INT; static constexpr bool packed = false; };
+template <> struct GlComponent<Int2101010> { static constexpr GLenum type = GL_INT_2_10_10_10_REV; static constexpr bool packed = true; };
+template <> struct GlComponent<UInt2101010> { static constexpr GLenum type = GL_UNSIGNED_INT_2_10_10_10_REV; static constexpr bool packed = true; };
+
+// One attribute at a shader location: Components values of type T.
+template <GLuint Location, typename T, GLint Components, AttribKind Kind = AttribKind::Float>
+struct Attr {
+    static_assert(Components >= 1 && Components <= 4, "attributes have one to four components");
+    static_assert(!GlComponent<T>::packed || Components == 4, "packed types hold four components");
+    static_assert(Kind != AttribKind::Integer || (GlComponent<T>::type != GL_FLOAT &&
+                  GlComponent<T>::type != GL_HALF_FLOAT && !GlComponent<T>::packed),
+                  "integer attributes need an integer type");
+
+    static constexpr size_t size = GlComponent<T>::packed ? sizeof(T) : sizeof(T) * Components;
+    static constexpr size_t alignment = sizeof(T);
+
+    static void pointer(GLsizei stride, size_t offset) {
+        glEnableVertexAttribArray(Location);
+        if (Kind == AttribKind::Integer)
+            glVertexAttribIPointer(Location, Components, GlComponent<T>::type, stride, (void*)offset);
+        else
+            glVertexAttribPointer(Location, Components, GlComponent<T>::type,
+                                  Kind == AttribKind::Normalized ? GL_TRUE : GL_FALSE, stride, (void*)offset);
+    }
+
+    static void format(GLuint binding, GLuint offset) {
+        glEnableVertexAttribArray(Location);
+        if (Kind == AttribKind::Integer)
+            glVertexAttribIFormat(Location, Components, GlComponent<T>::type, offset);
+        else
+            glVertexAttribFormat(Location, Components, GlComponent<T>::type,
+                                 Kind == AttribKind::Normalized ? GL_TRUE : GL_FALSE, offset);
+        glVertexAttribBinding(Location, binding);
+    }
+
+    static void divisor(GLuint divisor) { glVertexAttribDivisor(Location, divisor); }
+};
+
+// bytes of the vertex the shader doesn't read
+template <size_t Bytes>
+struct Skip {
+    static constexpr size_t size = Bytes;
+    static constexpr size_t alignment = 1;
+
+    static void pointer(GLsizei, size_t) {}
+    static void format(GLuint, GLuint) {}
+    static void divisor(GLuint) {}
+};
+
+template <GLuint Location> using Float2 = Attr<Location, float, 2>;
+template <GLuint Location> using Float3 = Attr<Location, float, 3>;
+template <GLuint Location> using Float4 = Attr<Location, float, 4>;
+template <GLuint Location> using Half2 = Attr<Location, Half, 2>;
+template <GLuint Location> using Half4 = Attr<Location, Half, 4>;
+// colors
+template <GLuint Location> using Unorm8x4 = Attr<Location, uint8_t, 4, AttribKind::Normalized>;
+// texture coordinates in [0, 1], octahedral normals
+template <GLuint Location> using Unorm16x2 = Attr<Location, uint16_t, 2, AttribKind::Normalized>;
+template <GLuint Location> using Snorm16x2 = Attr<Location, int16_t, 2, AttribKind::Normalized>;
+// normals and tangents, w holds the bitangent sign
+template <GLuint Location> using Snorm2101010 = Attr<Location, Int2101010, 4, AttribKind::Normalized>;
+
+namespace detail {
+
+template <size_t Offset, typename... Attrs>
+struct AttribList {
+    static constexpr size_t end = Offset;
+
+    static void pointers(GLsizei, size_t) {}
+    static void formats(GLuint) {}
+    static void divisors(GLuint) {}
+};
+
+template <size_t Offset, typename A, typename... Rest>
+struct AttribList<Offset, A, Rest...> {
+    static_assert(Offset % A::alignment == 0, "attribute offset is not a multiple of its component size");
+    using Next = AttribList<Offset + A::size, Rest...>;
+    static constexpr size_t end = Next::end;
+
+    static void pointers(GLsizei stride, size_t base) {
+        A::pointer(stride, base + Offset);
+        Next::pointers(stride, base);
+    }
+    static void formats(GLuint binding) {
+        A::format(binding, GLuint(Offset));
+        Next::formats(binding);
+    }
+    static void divisors(GLuint divisor) {
+        A::divisor(divisor);
+        Next::divisors(divisor);
+    }
+};
+
+};
+
+// Interleaved vertex format, attributes in memory order. Offsets and the stride are computed by
+// the compiler and the setup unrolls into the GL calls, e.g.
+//     using TexturedVertex = VertexLayout<Float3<0>, Float3<1>, Float2<2>>;
+template <typename... Attrs>
+struct VertexLayout {
+    static constexpr GLsizei stride = GLsizei(detail::AttribList<0, Attrs...>::end);
+
+    // glVertexAttribPointer for the bound vertex array and GL_ARRAY_BUFFER, vertices start at
+    // baseOffset bytes into the buffer
+    static void setPointers(size_t baseOffset = 0) {
+        detail::AttribList<0, Attrs...>::pointers(stride, baseOffset);
+    }
+
+    // GL 4.3 separate format of the bound vertex array, buffers are attached with bindBuffer
+    static void setFormat(GLuint binding = 0) {
+        detail::AttribList<0, Attrs...>::formats(binding);
+    }
+
+    static void bindBuffer(GLuint buffer, GLuint binding = 0, GLintptr baseOffset = 0) {
+        glBindVertexBuffer(binding, buffer, baseOffset, stride);
+    }
+
+    // vertex array setup for one buffer, with the separate format when the context has it. A
+    // divisor makes the attributes per instance (an own binding index in the separate format).
+    static void setup(GLuint buffer, GLuint binding = 0, GLuint divisor = 0) {
+        if (glInfo().vertexAttribBinding) {
+            setFormat(binding);
+            bindBuffer(buffer, binding);
+            glVertexBindingDivisor(binding, divisor);
+        } else {
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            setPointers();
+            detail::AttribList<0, Attrs...>::divisors(divisor);
+        }
+    }
+};
+
+};
+
+#endif //PROJECT_BASE_VERTEXLAYOUT_H
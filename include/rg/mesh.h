@@ -61,7 +61,7 @@ public:
                 ASSERT(false, "Unknown texture type");
             }
             name.append(number);
-            shader.setInt(name, i); // texture_diffuse1
+            shader.setInt(name.c_str(), i); // texture_diffuse1
             glBindTexture(GL_TEXTURE_2D, textures[i].id);
         }
 
@@ -0,0 +1,102 @@
+#version 430 core
+layout (local_size_x = 64) in;
+
+// Frustum, normal cone and Hi-Z culling of one frame's draws, see rg::GpuCulling. Every visible draw is
+// copied to the front of its group's range of the output commands.
+
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+struct DrawBounds {
+    vec4 sphere;
+    // axis and sine of the spread of the triangle normals, above 1 never culls
+    vec4 cone;
+    uint group;
+    uint groupFirst;
+    uint padding0;
+    uint padding1;
+};
+
+layout (std430, binding = 0) readonly buffer Bounds { DrawBounds bounds[]; };
+layout (std430, binding = 1) readonly buffer Commands { DrawCommand commands[]; };
+layout (std430, binding = 2) writeonly buffer Visible { DrawCommand visible[]; };
+layout (std430, binding = 3) buffer Counts { uint counts[]; };
+
+uniform int drawCount;
+uniform vec4 planes[6];
+uniform vec3 cameraPosition;
+uniform bool useHiZ;
+// the pyramid holds the previous frame's depth, seen through that frame's camera
+uniform mat4 hiZViewProjection;
+uniform sampler2D hiZDepth;
+uniform vec2 hiZSize;
+uniform int hiZLevels;
+
+bool insideFrustum(vec4 sphere)
+{
+    for (int i = 0; i < 6; ++i) {
+        if (dot(planes[i].xyz, sphere.xyz) + planes[i].w < -sphere.w)
+            return false;
+    }
+    return true;
+}
+
+// every triangle of the draw faces away from the camera, rg::backfacing() on the CPU
+bool backfacing(vec4 sphere, vec4 cone)
+{
+    vec3 toCenter = sphere.xyz - cameraPosition;
+    return cone.w <= 1.0 && dot(toCenter, cone.xyz) >= cone.w * length(toCenter) + sphere.w;
+}
+
+bool occluded(vec4 sphere)
+{
+    // screen rectangle and nearest depth of the sphere's bounding box
+    vec3 lo = sphere.xyz - sphere.w;
+    vec3 hi = sphere.xyz + sphere.w;
+    vec2 minUv = vec2(1.0);
+    vec2 maxUv = vec2(0.0);
+    float nearest = 1.0;
+    for (int i = 0; i < 8; ++i) {
+        vec3 corner = vec3((i & 1) != 0 ? hi.x : lo.x, (i & 2) != 0 ? hi.y : lo.y, (i & 4) != 0 ? hi.z : lo.z);
+        vec4 clip = hiZViewProjection * vec4(corner, 1.0);
+        // reaches behind the camera, the rectangle would be wrong
+        if (clip.w <= 0.0)
+            return false;
+        vec3 ndc = clip.xyz / clip.w;
+        minUv = min(minUv, ndc.xy * 0.5 + 0.5);
+        maxUv = max(maxUv, ndc.xy * 0.5 + 0.5);
+        nearest = min(nearest, ndc.z * 0.5 + 0.5);
+    }
+    minUv = clamp(minUv, 0.0, 1.0);
+    maxUv = clamp(maxUv, 0.0, 1.0);
+
+    // the level where the rectangle is at most one texel wide, so 2x2 texels cover it
+    vec2 extent = (maxUv - minUv) * hiZSize;
+    int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, hiZLevels - 1);
+    ivec2 levelSize = textureSize(hiZDepth, level);
+    ivec2 a = clamp(ivec2(minUv * vec2(levelSize)), ivec2(0), levelSize - 1);
+    ivec2 b = clamp(ivec2(maxUv * vec2(levelSize)), ivec2(0), levelSize - 1);
+    float farthest = max(max(texelFetch(hiZDepth, a, level).r, texelFetch(hiZDepth, ivec2(b.x, a.y), level).r),
+                         max(texelFetch(hiZDepth, ivec2(a.x, b.y), level).r, texelFetch(hiZDepth, b, level).r));
+    return nearest > farthest;
+}
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= uint(drawCount))
+        return;
+    vec4 sphere = bounds[i].sphere;
+    // a negative radius is never culled
+    bool visibleDraw = sphere.w < 0.0 || (insideFrustum(sphere) && !backfacing(sphere, bounds[i].cone)
+                                          && !(useHiZ && occluded(sphere)));
+    if (visibleDraw) {
+        uint slot = atomicAdd(counts[bounds[i].group], 1u);
+        visible[bounds[i].groupFirst + slot] = commands[i];
+    }
+}
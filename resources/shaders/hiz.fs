@@ -0,0 +1,30 @@
+#version 330 core
+
+// one level of the Hi-Z pyramid: the farthest depth of the texels under this one in the level
+// above, which is the only level previousLevel exposes
+uniform sampler2D previousLevel;
+
+void main()
+{
+    ivec2 size = textureSize(previousLevel, 0);
+    ivec2 texel = ivec2(gl_FragCoord.xy) * 2;
+    ivec2 last = size - 1;
+    float depth = max(max(texelFetch(previousLevel, texel, 0).r,
+                          texelFetch(previousLevel, min(texel + ivec2(1, 0), last), 0).r),
+                      max(texelFetch(previousLevel, min(texel + ivec2(0, 1), last), 0).r,
+                          texelFetch(previousLevel, min(texel + ivec2(1, 1), last), 0).r));
+    // an odd size leaves a last column or row that only the last texel of this level covers
+    bool extraColumn = (size.x & 1) != 0 && texel.x + 2 == last.x;
+    bool extraRow = (size.y & 1) != 0 && texel.y + 2 == last.y;
+    if (extraColumn) {
+        depth = max(depth, texelFetch(previousLevel, ivec2(last.x, texel.y), 0).r);
+        depth = max(depth, texelFetch(previousLevel, ivec2(last.x, min(texel.y + 1, last.y)), 0).r);
+    }
+    if (extraRow) {
+        depth = max(depth, texelFetch(previousLevel, ivec2(texel.x, last.y), 0).r);
+        depth = max(depth, texelFetch(previousLevel, ivec2(min(texel.x + 1, last.x), last.y), 0).r);
+    }
+    if (extraColumn && extraRow)
+        depth = max(depth, texelFetch(previousLevel, last, 0).r);
+    gl_FragDepth = depth;
+}
@@ -1,9 +1,40 @@
 #version 330 core
+// Variants differ in the features and light counts below. Loaded as SPIR-V they are
+// specialization constants of one module, set by rg::ShaderPermutations through
+// glSpecializeShader (the ids are rg::ShaderSpecialization). Compiled from GLSL they come from
+// the GAMMA, HAS_SPECULAR_MAP, HAS_NORMAL_MAP, FOG (0 or 1) and NR_*_LIGHTS defines it injects
+// after #version. Either way the branches on them are resolved at compile time.
+#ifdef GL_SPIRV
+#extension GL_ARB_explicit_uniform_location : require
+#extension GL_ARB_shading_language_420pack : require
+// names can't be looked up in a SPIR-V program, tools/ShaderReflect.cpp lists these
+#define LOCATION(n) layout (location = n)
+#define BINDING(n) , binding = n
+layout (constant_id = 0) const bool USE_GAMMA = false;
+layout (constant_id = 1) const bool USE_SPECULAR_MAP = false;
+layout (constant_id = 2) const bool USE_NORMAL_MAP = false;
+layout (constant_id = 3) const bool USE_FOG = false;
+layout (constant_id = 5) const int DIR_LIGHTS = 1;
+layout (constant_id = 6) const int POINT_LIGHTS = 4;
+layout (constant_id = 7) const int SPOT_LIGHTS = 1;
+#else
+#define LOCATION(n)
+#define BINDING(n)
+const bool USE_GAMMA = GAMMA != 0;
+const bool USE_SPECULAR_MAP = HAS_SPECULAR_MAP != 0;
+const bool USE_NORMAL_MAP = HAS_NORMAL_MAP != 0;
+const bool USE_FOG = FOG != 0;
+const int DIR_LIGHTS = NR_DIR_LIGHTS;
+const int POINT_LIGHTS = NR_POINT_LIGHTS;
+const int SPOT_LIGHTS = NR_SPOT_LIGHTS;
+#endif
+
 out vec4 FragColor;
 
 struct Material {
     sampler2D texture_diffuse1;
     sampler2D texture_specular1;
+    sampler2D texture_normal1;
     float shininess;
 };
 
@@ -42,18 +73,35 @@ struct SpotLight {
     vec3 specular;
 };
 
-#define NR_POINT_LIGHTS 4
-
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
+in vec3 Tangent;
+
+// all variants share one layout, the C++ side (rg::glsl::Lights) is generated from this block
+// by tools/ShaderReflect.cpp; POINT_LIGHTS selects how many of the entries are used
+#define MAX_POINT_LIGHTS 32
+layout (std140 BINDING(1)) uniform Lights {
+    DirLight dirLight;
+    SpotLight spotLight;
+    PointLight pointLights[MAX_POINT_LIGHTS];
+};
+
+// written once per frame (rg::glsl::Camera); every shader that draws in world space declares
+// this block the same way, the generator rejects copies that differ
+layout (std140 BINDING(0)) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+// material.* take locations 1 to 4
+LOCATION(1) uniform Material material;
+LOCATION(5) uniform vec3 fogColor;
+LOCATION(6) uniform float fogDensity;
 
-uniform vec3 viewPos;
-uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform SpotLight spotLight;
-uniform Material material;
-uniform bool gamma;
+// the maps are sampled once per fragment, not once per light
+vec3 diffuseColor;
+vec3 specularColor;
 
 // function prototypes
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
@@ -64,7 +112,15 @@ void main()
 {
     // properties
     vec3 norm = normalize(Normal);
+    if (USE_NORMAL_MAP) {
+        vec3 T = normalize(Tangent - dot(Tangent, norm) * norm);
+        mat3 TBN = mat3(T, cross(norm, T), norm);
+        norm = normalize(TBN * (texture(material.texture_normal1, TexCoords).rgb * 2.0 - 1.0));
+    }
     vec3 viewDir = normalize(viewPos - FragPos);
+    diffuseColor = vec3(texture(material.texture_diffuse1, TexCoords));
+    // materials without a specular map have no highlights
+    specularColor = USE_SPECULAR_MAP ? vec3(texture(material.texture_specular1, TexCoords)) : vec3(0.0);
 
     // == =====================================================
     // Our lighting is set up in 3 phases: directional, point lights and an optional flashlight
@@ -72,14 +128,21 @@ void main()
     // per lamp. In the main() function we take all the calculated colors and sum them up for
     // this fragment's final color.
     // == =====================================================
+    vec3 result = vec3(0.0);
     // phase 1: directional lighting
-    vec3 result = CalcDirLight(dirLight, norm, viewDir);
+    if (DIR_LIGHTS > 0)
+        result += CalcDirLight(dirLight, norm, viewDir);
     // phase 2: point lights
-    for(int i = 0; i < NR_POINT_LIGHTS; i++)
+    for(int i = 0; i < POINT_LIGHTS; i++)
         result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
     // phase 3: spot light
-    result += CalcSpotLight(spotLight, norm, FragPos, viewDir);
-    if(gamma)
+    if (SPOT_LIGHTS > 0)
+        result += CalcSpotLight(spotLight, norm, FragPos, viewDir);
+    if (USE_FOG) {
+        float fogDistance = length(viewPos - FragPos);
+        result = mix(fogColor, result, exp(-fogDensity * fogDensity * fogDistance * fogDistance));
+    }
+    if (USE_GAMMA)
         result = pow(result, vec3(1.0/2.2));
     FragColor = vec4(result, 1.0);
 }
@@ -96,9 +159,9 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     vec3 halfwayDir = normalize(lightDir + viewDir);
     float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
+    vec3 ambient = light.ambient * diffuseColor;
+    vec3 diffuse = light.diffuse * diff * diffuseColor;
+    vec3 specular = light.specular * spec * specularColor;
     return (ambient + diffuse + specular);
 }
 
@@ -117,11 +180,11 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     // attenuation
     float distance = length(light.position - fragPos);
     //float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
-    float attenuation = 1.0 / (gamma ? distance * distance : distance);
+    float attenuation = USE_GAMMA ? 1.0 / (distance * distance) : 1.0 / distance;
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
+    vec3 ambient = light.ambient * diffuseColor;
+    vec3 diffuse = light.diffuse * diff * diffuseColor;
+    vec3 specular = light.specular * spec * specularColor;
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
@@ -142,15 +205,15 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     // attenuation
     float distance = length(light.position - fragPos);
     //float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
-    float attenuation = 1.0 / (gamma ? distance * distance : distance);
+    float attenuation = USE_GAMMA ? 1.0 / (distance * distance) : 1.0 / distance;
     // spotlight intensity
     float theta = dot(lightDir, normalize(-light.direction));
     float epsilon = light.cutOff - light.outerCutOff;
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
+    vec3 ambient = light.ambient * diffuseColor;
+    vec3 diffuse = light.diffuse * diff * diffuseColor;
+    vec3 specular = light.specular * spec * specularColor;
     ambient *= attenuation * intensity;
     diffuse *= attenuation * intensity;
     specular *= attenuation * intensity;
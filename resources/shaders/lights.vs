@@ -1,21 +1,46 @@
 #version 330 core
+#ifdef GL_SPIRV
+// one module for every variant, see the constants in lights.fs
+#extension GL_ARB_explicit_uniform_location : require
+#extension GL_ARB_shading_language_420pack : require
+#define LOCATION(n) layout (location = n)
+#define BINDING(n) , binding = n
+layout (constant_id = 2) const bool USE_NORMAL_MAP = false;
+layout (constant_id = 4) const bool USE_MULTI_DRAW = false;
+#else
+#define LOCATION(n)
+#define BINDING(n)
+const bool USE_NORMAL_MAP = HAS_NORMAL_MAP != 0;
+const bool USE_MULTI_DRAW = MULTI_DRAW != 0;
+#endif
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec3 aTangent;
+// per draw with USE_MULTI_DRAW, read at the baseInstance of the indirect command
+layout (location = 5) in mat4 aModel;
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
+out vec3 Tangent;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+LOCATION(0) uniform mat4 model;
+// as declared in lights.fs
+layout (std140 BINDING(0)) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    mat4 world = USE_MULTI_DRAW ? aModel : model;
+    FragPos = vec3(world * vec4(aPos, 1.0));
+    mat3 normalMatrix = mat3(transpose(inverse(world)));
+    Normal = normalMatrix * aNormal;
+    Tangent = USE_NORMAL_MAP ? normalMatrix * aTangent : vec3(0.0);
     TexCoords = aTexCoords;
 
     gl_Position = projection * view * vec4(FragPos, 1.0);
-}
\ No newline at end of file
+}
@@ -14,6 +14,23 @@
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
 
+#include <rg/SceneGenerator.h>
+#include <rg/Benchmark.h>
+#include <rg/Profiler.h>
+#include <rg/RenderStats.h>
+#include <rg/AllocationTracker.h>
+#include <rg/LinearAllocator.h>
+#include <rg/GlExtensions.h>
+#include <rg/DebugOutput.h>
+#include <rg/DynamicBatch.h>
+#include <rg/GpuCulling.h>
+#include <rg/HiZPyramid.h>
+#include <rg/StaticBatch.h>
+#include <rg/TextureUploader.h>
+#include <rg/ShaderLibrary.h>
+#include <rg/UniformBlocks.h>
+#include <rg/VertexLayout.h>
+
 #include <iostream>
 #include <math.h>
 
@@ -37,38 +54,25 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-struct DirLight {
-    glm::vec3 direction;
-
-    glm::vec3 ambient;
-    glm::vec3 diffuse;
-    glm::vec3 specular;
-};
-
-struct PointLight {
-    glm::vec3 position;
-    glm::vec3 ambient;
-    glm::vec3 diffuse;
-    glm::vec3 specular;
-
-    float constant;
-    float linear;
-    float quadratic;
-};
-
-struct SpotLight {
-    glm::vec3 position;
-    glm::vec3 direction;
-    float cutOff;
-    float outerCutOff;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    glm::vec3 ambient;
-    glm::vec3 diffuse;
-    glm::vec3 specular;
+// the light structs are generated from lights.fs, laid out the way its std140 Lights block expects
+using DirLight = rg::glsl::DirLight;
+using PointLight = rg::glsl::PointLight;
+using SpotLight = rg::glsl::SpotLight;
+
+static_assert(sizeof(rg::glsl::Lights::pointLights) / sizeof(PointLight) >= rg::MAX_POINT_LIGHTS,
+              "MAX_POINT_LIGHTS in lights.fs is smaller than the scene generator's limit");
+
+// vertex formats of the arrays defined in main()
+using LightCubeVertex = rg::VertexLayout<rg::Float3<0>, rg::Skip<5 * sizeof(float)>>;
+using TargetVertex = rg::VertexLayout<rg::Float3<0>, rg::Float3<1>, rg::Float2<2>>;
+using WindowVertex = rg::VertexLayout<rg::Float3<0>, rg::Float2<1>>;
+using SkyboxVertex = rg::VertexLayout<rg::Float3<0>>;
+// the batched light cubes leave out the normal and texture coords the shader doesn't read
+using LightCubeBatchVertex = rg::VertexLayout<rg::Float3<0>>;
+
+struct WindowDrawOrder {
+    float distance;
+    unsigned int index;
 };
 
 struct ProgramState {
@@ -82,10 +86,45 @@ struct ProgramState {
     glm::vec3 dragonPosition = glm::vec3(4.0f,4.0f,-10.0f);
     float dragonScale = 0.2f;
     DirLight dirLight;
-    PointLight pointLights[4];
+    std::vector<PointLight> pointLights;
     SpotLight spotLight;
+    rg::glsl::Lights lights;
+    // every per-frame upload: uniform blocks, draw commands and instances, batched vertices
+    rg::StreamBuffer frameRing;
     float materialShininess = 16.0f; // 32.0f
     bool gamma = false;
+    bool fog = false;
+    float fogDensity = 0.05f;
+    unsigned litShaderVariants = 0;
+    const MeshGeometryPool* meshGeometry = nullptr;
+    rg::CullMode culling = rg::CullMode::Frustum;
+    bool gpuCulling = false;
+    // queue the meshlets of big meshes as draws of their own, with multi-draw only
+    bool clusterCulling = true;
+    // screen-size level of detail, the level of every rock and dragon in the last frame
+    rg::LodView lod;
+    std::vector<int> rockLods;
+    std::vector<int> dragonLods;
+    // the rocks never move, they are merged into static batches (without LOD)
+    bool staticBatching = true;
+    unsigned staticBatches = 0;
+    unsigned staticCopies = 0;
+    // the light cubes, targets and windows are transformed on the CPU and drawn one call per pass
+    bool dynamicBatching = true;
+    unsigned dynamicBatchMaxVertices = rg::DYNAMIC_BATCH_MAX_VERTICES;
+    unsigned dynamicCopies = 0;
+    unsigned dynamicDraws = 0;
+    // scene generator and frame time sweeps
+    rg::SceneConfig sceneConfig;
+    rg::SceneLayout scene;
+    bool sceneDirty = true;
+    rg::SceneSweep sweep;
+    char sweepSpec[128] = "scale=1,2,4,8";
+    std::string benchmarkOutput;
+    bool exitAfterSweep = false;
+    rg::GpuProfiler gpuProfiler;
+    // transient per-frame data, reset at the start of every frame
+    rg::LinearAllocator frameArena{1 << 20};
     ProgramState()
     : camera(glm::vec3(0.0f, 0.0f, 3.0f)) {}
 };
@@ -93,20 +132,40 @@ struct ProgramState {
 ProgramState *programState;
 
 void DrawImGui(ProgramState *programState);
+void BuildScene(ProgramState *programState);
+bool StartSweep(ProgramState *programState, const std::vector<std::string> &specs);
+void SetLightingUniforms(Shader &shader, ProgramState *programState);
+
+int main(int argc, char **argv) {
+    rg::CommandLineOptions options;
+    if (!rg::parseCommandLine(argc, argv, options))
+        return -1;
 
-int main() {
     // glfw: initialize and configure
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    // the context has to outlive the models and other GL object owners that are locals of main()
+    struct GlfwTerminator {
+        ~GlfwTerminator() { glfwTerminate(); }
+    } glfwTerminator;
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    if (rg::DebugOutput::requested())
+        glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
 
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-    // glfw window creation
-    GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Project", NULL, NULL);
+    // glfw window creation, the renderer needs 3.3 but asks for the newest context so the
+    // optional paths (program binaries, ...) can be used where the driver has them
+    const int contextVersions[][2] = {{4, 6}, {4, 5}, {4, 3}, {4, 1}, {3, 3}};
+    GLFWwindow *window = NULL;
+    for (const auto &version : contextVersions) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, version[0]);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, version[1]);
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Project", NULL, NULL);
+        if (window != NULL)
+            break;
+    }
     if (window == NULL) {
         std::cout << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
@@ -124,10 +183,20 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    rg::loadGlExtensions((GLADloadproc) glfwGetProcAddress);
+    rg::DebugOutput::enable();
+    std::cout << "OpenGL " << rg::glInfo().version << ", " << rg::glInfo().renderer << std::endl;
 
     //stbi_set_flip_vertically_on_load(true);
+    // files are decoded on a worker thread and their texels streamed in under a per frame budget
+    rg::textureUploader().init(options.textureBudget);
 
     programState = new ProgramState;
+    programState->sceneConfig = options.scene;
+    programState->sweep.warmupFrames = options.warmupFrames;
+    programState->sweep.measureFrames = options.measureFrames;
+    programState->benchmarkOutput = options.benchmarkOutput;
+    programState->culling = options.culling;
     if (programState->CameraMouseMovementUpdateEnabled) {
         glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
     }
@@ -146,11 +215,13 @@ int main() {
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    Shader lightingShader("resources/shaders/lights.vs", "resources/shaders/lights.fs");
-    Shader lightCubeShader("resources/shaders/light_cube.vs", "resources/shaders/light_cube.fs");
-    Shader targetShader("resources/shaders/target_shader.vs", "resources/shaders/target_shader.fs");
-    Shader windowShader("resources/shaders/windows.vs", "resources/shaders/windows.fs");
-    Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
+    // all programs compile while the models and textures below are loading
+    rg::ShaderLibrary shaders;
+    rg::ShaderPermutations litShaders(shaders, "resources/shaders/lights.vs", "resources/shaders/lights.fs");
+    Shader &lightCubeShader = shaders.add("resources/shaders/light_cube.vs", "resources/shaders/light_cube.fs");
+    Shader &targetShader = shaders.add("resources/shaders/target_shader.vs", "resources/shaders/target_shader.fs");
+    Shader &windowShader = shaders.add("resources/shaders/windows.vs", "resources/shaders/windows.fs");
+    Shader &skyboxShader = shaders.add("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
 
     float vertices[] = {
             // positions          // normals           // texture coords
@@ -196,77 +267,64 @@ int main() {
             -0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  0.0f,
             -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  1.0f
     };
-    // positions all containers
-    glm::vec3 cubePositions[] = {
-            glm::vec3( 0.0f,  0.0f,  0.0f),
-            glm::vec3( 2.0f,  5.0f, -15.0f),
-            glm::vec3(-1.5f, -2.2f, -2.5f),
-            glm::vec3(-3.8f, -2.0f, -12.3f),
-            glm::vec3( 2.4f, -0.4f, -3.5f),
-            glm::vec3(-1.7f,  3.0f, -7.5f),
-            glm::vec3( 1.3f, -2.0f, -2.5f),
-            glm::vec3( 1.5f,  2.0f, -2.5f),
-            glm::vec3( 1.5f,  0.2f, -1.5f),
-            glm::vec3(-1.3f,  1.0f, -1.5f)
-    };
-    // positions of the point lights
-    glm::vec3 pointLightPositions[] = {
-            glm::vec3( 0.7f,  0.2f,  2.0f),
-            glm::vec3( 1.5f, -1.3f, -2.0f),
-            glm::vec3(-2.0f,  2.0f, -4.0f),
-            glm::vec3( 1.0f,  1.0f, -3.0f)
-    };
-    // positions of the rock models
-    glm:: vec3 rockPositions[] = {
-            glm::vec3( 3.0f, 4.1f,  -5.0f),
-            glm::vec3( 4.5f, -2.5f, -8.3f),
-            glm::vec3(-4.4f,  5.6f, -9.0f),
-            glm::vec3( -3.0f,  -3.2f, -6.4f)
-    };
-    // configure the cube's VAO (and VBO)
-    unsigned int VBO, cubeVAO;
-    glGenVertexArrays(1, &cubeVAO);
+    // the light cube's VBO, the lit containers are built from the same vertices into the geometry pool
+    unsigned int VBO;
     glGenBuffers(1, &VBO);
 
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    rg::gl::BufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
-    glBindVertexArray(cubeVAO);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-
-    // second, configure the light's VAO (VBO stays the same; the vertices are the same for the light object which is also a 3D cube)
     unsigned int lightCubeVAO;
     glGenVertexArrays(1, &lightCubeVAO);
-    glBindVertexArray(lightCubeVAO);
+    rg::gl::BindVertexArray(lightCubeVAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    // note that we update the lamp's position attribute's stride to reflect the updated buffer data
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    // only the position, the stride still covers the normal and texture coords of the cube vertices
+    LightCubeVertex::setup(VBO);
 
     // load textures (we now use a utility function to keep the code more organized)
     unsigned int diffuseMap = loadTexture(FileSystem::getPath("resources/textures/container2.png").c_str(), false);
     unsigned int diffuseMapGammaCorrected = loadTexture(FileSystem::getPath("resources/textures/container2.png").c_str(), true);
     unsigned int specularMap = loadTexture(FileSystem::getPath("resources/textures/container2_specular.png").c_str(),false);
 
-    lightingShader.use();
-    lightingShader.setInt("material.texture_diffuse1", 0);
-    lightingShader.setInt("material.texture_specular1", 1);
-
-    // load models
-    Model rockModel("resources/objects/rock/rock.obj");
+    // load models, all of their meshes share the pool's buffers and vertex array
+    MeshGeometryPool meshGeometry;
+    programState->meshGeometry = &meshGeometry;
+    // the rocks and dragons are instanced all over the scene, far ones draw simplified meshes
+    // the static batches are built from the rock vertices, they stay on the CPU
+    Model rockModel("resources/objects/rock/rock.obj", meshGeometry, false, true, 4);
     rockModel.SetShaderTextureNamePrefix("material.");
 
-    Model bowModel("resources/objects/bow/bow.obj");
+    Model bowModel("resources/objects/bow/bow.obj", meshGeometry);
     bowModel.SetShaderTextureNamePrefix("material.");
 
-    Model dragonModel("resources/objects/dragon/smaug.obj");
+    Model dragonModel("resources/objects/dragon/smaug.obj", meshGeometry, false, false, 4);
     dragonModel.SetShaderTextureNamePrefix("material.");
+    // rebuilt with the scene, draws the rocks in world space
+    rg::StaticBatch staticScene;
+
+    // the containers are pool meshes as well, one per diffuse map so gamma is a different material
+    vector<Vertex> containerVertices(36);
+    vector<unsigned int> containerIndices(36);
+    for (unsigned int i = 0; i < 36; i++) {
+        const float* v = vertices + i * 8;
+        containerVertices[i].Position = glm::vec3(v[0], v[1], v[2]);
+        containerVertices[i].Normal = glm::vec3(v[3], v[4], v[5]);
+        containerVertices[i].TexCoords = glm::vec2(v[6], v[7]);
+        containerIndices[i] = i;
+    }
+    Mesh containerMesh(meshGeometry, vector<Vertex>(containerVertices), vector<unsigned int>(containerIndices),
+                       {Texture{diffuseMap, "texture_diffuse", ""}, Texture{specularMap, "texture_specular", ""}});
+    containerMesh.SetShaderTextureNamePrefix("material.");
+    Mesh containerMeshGamma(meshGeometry, std::move(containerVertices), std::move(containerIndices),
+                            {Texture{diffuseMapGammaCorrected, "texture_diffuse", ""}, Texture{specularMap, "texture_specular", ""}});
+    containerMeshGamma.SetShaderTextureNamePrefix("material.");
+
+    // every lit opaque draw of a frame, the model matrices reach the shader as an instanced attribute
+    MeshDrawList litDraws;
+    // ring buffer the instanced attribute points at
+    uint64_t litInstancesGeneration = 0;
+    rg::StreamBuffer& frameRing = programState->frameRing;
+    frameRing.init(1 << 20);
 
     for (auto& texture : rockModel.textures_loaded)
         std::cerr << texture.path << ' ' << texture.type << '\n';
@@ -281,18 +339,6 @@ int main() {
     dirLight.diffuse = glm::vec3(0.4f, 0.4f, 0.4f);
     dirLight.specular = glm::vec3 (0.5f,0.5f,0.5f);
 
-    for (int i=0; i<4; i++) {
-        PointLight& pointLight = programState->pointLights[i];
-        pointLight.position = pointLightPositions[i];
-        pointLight.ambient = glm::vec3(0.05f, 0.05f, 0.05f);
-        pointLight.diffuse = glm::vec3(0.8f, 0.8f, 0.8f);
-        pointLight.specular = glm::vec3(1.0f, 1.0f, 1.0f);
-
-        pointLight.constant = 1.0f;
-        pointLight.linear = 0.09f;
-        pointLight.quadratic = 0.032f;
-    }
-
     SpotLight& spotLight = programState->spotLight;
     spotLight.ambient = glm::vec3 (0.0f,0.0f,0.0f);
     spotLight.diffuse = glm::vec3 (1.0f,1.0f,1.0f);
@@ -324,29 +370,24 @@ int main() {
     glGenBuffers(1, &VBO1);
     glGenBuffers(1, &EBO1);
 
-    glBindVertexArray(VAO1);
+    rg::gl::BindVertexArray(VAO1);
 
     glBindBuffer(GL_ARRAY_BUFFER, VBO1);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(targetVertices), targetVertices, GL_STATIC_DRAW);
+    rg::gl::BufferData(GL_ARRAY_BUFFER, sizeof(targetVertices), targetVertices, GL_STATIC_DRAW);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO1);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    // color attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    // texture coord attribute
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
+    rg::gl::BufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+    // position, color and texture coord attributes
+    TargetVertex::setup(VBO1);
 
     unsigned int targetTexture = loadTexture(FileSystem::getPath("resources/textures/grass.jpg").c_str(),false);
     unsigned int targetTexture1 = loadTexture(FileSystem::getPath("resources/textures/target.png").c_str(),false);
-    targetShader.use();
-    targetShader.setInt("texture1", 0);
-    targetShader.setInt("texture2", 1);
+    shaders.setInitializer(targetShader, [](Shader &shader) {
+        shader.use();
+        shader.setInt("texture1", 0);
+        shader.setInt("texture2", 1);
+    });
 
     // define verticles for window
     float windowVertices[] = {
@@ -360,30 +401,22 @@ int main() {
             1.0f,  0.5f,  0.0f,  1.0f,  0.0f
     };
 
-    vector<glm::vec3> windowPositions = {
-            glm::vec3( 3.0f,  4.1f,  -3.0f),
-            glm::vec3( 3.0f, 4.1f, -7.0f),
-            glm::vec3(-3.0f,  -3.2f, -9.1f),
-            glm::vec3( 1.0f,  1.0f, -10.9f)
-    };
-
     // send to GPU
     unsigned int windowVAO, windowVBO;
     glGenVertexArrays(1, &windowVAO);
     glGenBuffers(1, &windowVBO);
-    glBindVertexArray(windowVAO);
+    rg::gl::BindVertexArray(windowVAO);
     glBindBuffer(GL_ARRAY_BUFFER, windowVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(windowVertices), windowVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glBindVertexArray(0);
+    rg::gl::BufferData(GL_ARRAY_BUFFER, sizeof(windowVertices), windowVertices, GL_STATIC_DRAW);
+    WindowVertex::setup(windowVBO);
+    rg::gl::BindVertexArray(0);
 
     unsigned int windowTexture = loadTexture(FileSystem::getPath("resources/textures/window.png").c_str(),false);
 
-    windowShader.use();
-    windowShader.setInt("texture1", 0);
+    shaders.setInitializer(windowShader, [](Shader &shader) {
+        shader.use();
+        shader.setInt("texture1", 0);
+    });
 
     //cubemap implementation
     float skyboxVertices[] = {
@@ -435,11 +468,10 @@ int main() {
     unsigned int skyboxVAO, skyboxVBO;
     glGenVertexArrays(1, &skyboxVAO);
     glGenBuffers(1, &skyboxVBO);
-    glBindVertexArray(skyboxVAO);
+    rg::gl::BindVertexArray(skyboxVAO);
     glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    rg::gl::BufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
+    SkyboxVertex::setup(skyboxVBO);
 
     vector<std::string> faces
     {
@@ -452,232 +484,388 @@ int main() {
     };
     unsigned int cubemapTexture = loadCubemap(faces);
 
-    skyboxShader.use();
-    skyboxShader.setInt("skybox",0);
+    shaders.setInitializer(skyboxShader, [](Shader &shader) {
+        shader.use();
+        shader.setInt("skybox",0);
+    });
+
+    // the small meshes are batched from their CPU copies into the frame ring
+    const rg::DynamicMesh lightCubeMesh{vertices, 8, 36};
+    const rg::DynamicMesh targetMesh{targetVertices, 8, 4, indices, 6};
+    const rg::DynamicMesh windowMesh{windowVertices, 5, 6};
+    rg::DynamicBatch<LightCubeBatchVertex> lightCubeBatch;
+    rg::DynamicBatch<TargetVertex> targetBatch;
+    rg::DynamicBatch<WindowVertex> windowBatch;
+    lightCubeBatch.init(frameRing);
+    targetBatch.init(frameRing);
+    windowBatch.init(frameRing);
+
+    // the lit draws are culled in a compute shader where the context has one, on the CPU otherwise
+    rg::GpuCulling culling;
+    culling.init(shaders);
+    rg::HiZPyramid hiZ;
+    if (culling.available())
+        hiZ.init(shaders);
+    programState->gpuCulling = culling.available();
+    if (options.hotReload)
+        shaders.watch(FileSystem::getPath("resources/shaders"));
+
+    rg::GpuProfiler& gpuProfiler = programState->gpuProfiler;
+    gpuProfiler.init();
+    programState->sweep.gpuProfiler = &gpuProfiler;
+
+    // the textures loaded so far are decoded alongside the model imports, the first frame has them
+    rg::textureUploader().finish();
+
+    if (!options.sweep.empty()) {
+        // don't let vsync hide the frame time differences between configurations
+        glfwSwapInterval(0);
+        programState->exitAfterSweep = true;
+        // a scripted sweep that measures nothing has to fail, not write an empty result
+        if (!StartSweep(programState, options.sweep))
+            return -1;
+    }
+
+    // lit variants get the material and fog settings when they are first bound in a frame, the
+    // camera and lights are uniform blocks
+    glm::mat4 projection, view;
+    litShaders.setupFrame = [](Shader &shader) {
+        SetLightingUniforms(shader, programState);
+    };
 
     // render loop
     while (!glfwWindowShouldClose(window)) {
+        PROFILE_ZONE("Frame");
         // per-frame time logic
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
+        rg::SceneSweep& sweep = programState->sweep;
+        programState->frameArena.reset();
+
+        if (sweep.isActive() && sweep.frame(deltaTime * 1000.0, rg::AllocationTracker::lastFrame().allocations)) {
+            programState->sceneConfig = sweep.currentConfig();
+            programState->sceneDirty = true;
+        }
+        if (programState->exitAfterSweep && !sweep.isActive()) {
+            if (!programState->benchmarkOutput.empty())
+                sweep.writeJson(programState->benchmarkOutput);
+            break;
+        }
+        if (programState->sceneDirty) {
+            BuildScene(programState);
+            staticScene.clear();
+            for (const glm::vec3& rock : programState->scene.rocks)
+                staticScene.add(rockModel, glm::scale(glm::translate(glm::mat4(1.0f), rock), glm::vec3(1.1f)));
+            staticScene.build(meshGeometry);
+            programState->staticBatches = (unsigned)staticScene.batches().size();
+            programState->staticCopies = (unsigned)staticScene.copyCount();
+        }
+        // hot reloaded programs are swapped in here, before anything is drawn
+        shaders.update();
+        programState->litShaderVariants = (unsigned)litShaders.size();
+        gpuProfiler.beginFrame();
+        // waits if the GPU is still STREAM_FRAMES frames behind
+        frameRing.beginFrame();
+        // texels of textures loaded mid-session, a few rows a frame for large ones
+        rg::textureUploader().update();
+        lightCubeBatch.maxVertices = targetBatch.maxVertices = windowBatch.maxVertices =
+                programState->dynamicBatchMaxVertices;
+        rg::SceneLayout& scene = programState->scene;
+
         // input
         processInput(window);
 
-        // sort the windows before rendering (argument is distance between camera and window descending)
-        std::sort(windowPositions.begin(), windowPositions.end(),
-                  [cameraPosition = programState->camera.Position](const glm::vec3& a, const glm::vec3& b) {
-            float d1 = glm::distance(a, cameraPosition);
-            float d2 = glm::distance(b, cameraPosition);
-            return d1 > d2;
-        });
+        // sort the windows before rendering (argument is distance between camera and window descending),
+        // distances are computed once per window into the frame arena instead of in every comparison
+        unsigned int windowCount = (unsigned int)scene.windows.size();
+        WindowDrawOrder* windowOrder = programState->frameArena.allocateArray<WindowDrawOrder>(windowCount);
+        {
+            PROFILE_ZONE("Sort windows");
+            const glm::vec3& cameraPosition = programState->camera.Position;
+            for (unsigned int i = 0; i < windowCount; i++)
+                windowOrder[i] = WindowDrawOrder{glm::distance(scene.windows[i], cameraPosition), i};
+            std::sort(windowOrder, windowOrder + windowCount, [](const WindowDrawOrder& a, const WindowDrawOrder& b) {
+                return a.distance > b.distance;
+            });
+        }
 
         // render
         glClearColor(programState->clearColor.x,programState->clearColor.y, programState->clearColor.z,1.0);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        lightingShader.use();
-        lightingShader.setVec3("viewPos", programState->camera.Position);
-        lightingShader.setFloat("material.shininess", programState-> materialShininess);
-
-        lightingShader.setVec3("dirLight.direction", programState->dirLight.direction);
-        lightingShader.setVec3("dirLight.ambient", programState->dirLight.ambient);
-        lightingShader.setVec3("dirLight.diffuse", programState->dirLight.diffuse);
-        lightingShader.setVec3("dirLight.specular", programState->dirLight.specular);
-
-        glm::vec3 dynamicPointLightsPositions[4];
-
-        // point light 1
-        dynamicPointLightsPositions[0] = glm::vec3(programState->pointLights[0].position.x * cos(currentFrame), programState->pointLights[0].position.y, programState->pointLights[0].position.z * sin(currentFrame));
-        lightingShader.setVec3("pointLights[0].position", dynamicPointLightsPositions[0]);
-        lightingShader.setVec3("pointLights[0].ambient", programState->pointLights[0].ambient);
-        lightingShader.setVec3("pointLights[0].diffuse", programState->pointLights[0].diffuse);
-        lightingShader.setVec3("pointLights[0].specular", programState->pointLights[0].specular);
-        lightingShader.setFloat("pointLights[0].constant", programState->pointLights[0].constant);
-        lightingShader.setFloat("pointLights[0].linear", programState->pointLights[0].linear);
-        lightingShader.setFloat("pointLights[0].quadratic", programState->pointLights[0].quadratic);
-        // point light 2
-        dynamicPointLightsPositions[1] = glm::vec3(programState->pointLights[1].position.x * cos(currentFrame), programState->pointLights[1].position.y, programState->pointLights[1].position.z * sin(currentFrame));
-        lightingShader.setVec3("pointLights[1].position", dynamicPointLightsPositions[1]);
-        lightingShader.setVec3("pointLights[1].ambient", programState->pointLights[1].ambient);
-        lightingShader.setVec3("pointLights[1].diffuse", programState->pointLights[1].diffuse);
-        lightingShader.setVec3("pointLights[1].specular", programState->pointLights[1].specular);
-        lightingShader.setFloat("pointLights[1].constant", programState->pointLights[1].constant);
-        lightingShader.setFloat("pointLights[1].linear", programState->pointLights[1].linear);
-        lightingShader.setFloat("pointLights[1].quadratic", programState->pointLights[1].quadratic);
-        // point light 3
-        dynamicPointLightsPositions[2] = glm::vec3(programState->pointLights[2].position.x, programState->pointLights[2].position.y * cos(currentFrame), programState->pointLights[2].position.z * sin(currentFrame));
-        lightingShader.setVec3("pointLights[2].position", dynamicPointLightsPositions[2]);
-        lightingShader.setVec3("pointLights[2].ambient", programState->pointLights[2].ambient);
-        lightingShader.setVec3("pointLights[2].diffuse", programState->pointLights[2].diffuse);
-        lightingShader.setVec3("pointLights[2].specular", programState->pointLights[2].specular);
-        lightingShader.setFloat("pointLights[2].constant", programState->pointLights[2].constant);
-        lightingShader.setFloat("pointLights[2].linear", programState->pointLights[2].linear);
-        lightingShader.setFloat("pointLights[2].quadratic", programState->pointLights[2].quadratic);
-        // point light 4
-        dynamicPointLightsPositions[3] = glm::vec3(programState->pointLights[3].position.x, programState->pointLights[3].position.y * cos(currentFrame), programState->pointLights[3].position.z * sin(currentFrame));
-        lightingShader.setVec3("pointLights[3].position", dynamicPointLightsPositions[3]);
-        lightingShader.setVec3("pointLights[3].ambient", programState->pointLights[3].ambient);
-        lightingShader.setVec3("pointLights[3].diffuse", programState->pointLights[3].diffuse);
-        lightingShader.setVec3("pointLights[3].specular", programState->pointLights[3].specular);
-        lightingShader.setFloat("pointLights[3].constant", programState->pointLights[3].constant);
-        lightingShader.setFloat("pointLights[3].linear", programState->pointLights[3].linear);
-        lightingShader.setFloat("pointLights[3].quadratic", programState->pointLights[3].quadratic);
-        // spotLight
-        lightingShader.setVec3("spotLight.position", programState->camera.Position);
-        lightingShader.setVec3("spotLight.direction", programState->camera.Front);
-        lightingShader.setVec3("spotLight.ambient", programState->spotLight.ambient);
-        lightingShader.setVec3("spotLight.diffuse", programState->spotLight.diffuse);
-        lightingShader.setVec3("spotLight.specular", programState->spotLight.specular);
-        lightingShader.setFloat("spotLight.constant", programState->spotLight.constant);
-        lightingShader.setFloat("spotLight.linear", programState->spotLight.linear);
-        lightingShader.setFloat("spotLight.quadratic", programState->spotLight.quadratic);
-        lightingShader.setFloat("spotLight.cutOff", programState->spotLight.cutOff);
-        lightingShader.setFloat("spotLight.outerCutOff", programState->spotLight.outerCutOff);
-
-        glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = programState->camera.GetViewMatrix();
-        lightingShader.setMat4("projection", projection);
-        lightingShader.setMat4("view", view);
-
-        glm::mat4 model = glm::mat4(1.0f);
-        lightingShader.setMat4("model", model);
-
-        //bind diffuse map
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, programState->gamma ? diffuseMapGammaCorrected : diffuseMap);
-        // bind specular map
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, specularMap);
-
-        lightingShader.setInt("gamma", programState->gamma);
-
-        // render containers
-        glBindVertexArray(cubeVAO);
-        for (unsigned int i = 0; i < 10; i++) {
-            // calculate the model matrix for each object and pass it to shader before drawing
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePositions[i]);
-            float angle = 20.0f * i;
-            if(i%3 == 1) {
-                angle = (1+sin(glfwGetTime()))/2 * 30.0f;
+        projection = glm::perspective(glm::radians(programState->camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        view = programState->camera.GetViewMatrix();
+        rg::glsl::Camera cameraBlock;
+        cameraBlock.projection = projection;
+        cameraBlock.view = view;
+        cameraBlock.viewPos = programState->camera.Position;
+        rg::uploadUniformBlock(frameRing, cameraBlock);
+        culling.mode = programState->culling;
+        culling.beginFrame(projection * view, programState->camera.Position, &hiZ);
+        // every meshlet is a command, without multi-draw it would be a draw call
+        bool clusters = programState->clusterCulling && culling.mode != rg::CullMode::Off &&
+                        rg::glInfo().multiDrawIndirect;
+        programState->sweep.culling = rg::cullModeName(culling.mode);
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        rg::LodView& lodView = programState->lod;
+        lodView.setPerspective(programState->camera.Position, programState->camera.Zoom, framebufferHeight);
+        programState->rockLods.resize(scene.rocks.size(), rg::LOD_CULLED);
+        programState->dragonLods.resize(scene.dragons.size(), rg::LOD_CULLED);
+        glm::mat4 model;
+        vector<glm::vec3>& dynamicPointLightsPositions = scene.pointLights;
+
+        {
+            rg::GpuScope pass(gpuProfiler, "Lit opaque");
+            PROFILE_ZONE("Lit opaque");
+            // the first two of every four lights orbit around the y axis, the other two around the x axis
+            for (unsigned int i = 0; i < programState->pointLights.size(); i++) {
+                const PointLight& pointLight = programState->pointLights[i];
+                if (i % 4 < 2)
+                    dynamicPointLightsPositions[i] = glm::vec3(pointLight.position.x * cos(currentFrame), pointLight.position.y, pointLight.position.z * sin(currentFrame));
+                else
+                    dynamicPointLightsPositions[i] = glm::vec3(pointLight.position.x, pointLight.position.y * cos(currentFrame), pointLight.position.z * sin(currentFrame));
+            }
+
+            // every light in one upload, shared by all lit variants; only the lights in the scene are sent
+            rg::glsl::Lights& lights = programState->lights;
+            lights.dirLight = programState->dirLight;
+            lights.spotLight = programState->spotLight;
+            lights.spotLight.position = programState->camera.Position;
+            lights.spotLight.direction = programState->camera.Front;
+            for (unsigned int i = 0; i < programState->pointLights.size(); i++) {
+                lights.pointLights[i] = programState->pointLights[i];
+                lights.pointLights[i].position = dynamicPointLightsPositions[i];
             }
-            if(i%3 == 2) {
-                angle = (1+cos(glfwGetTime()))/2 * 30.0f;
+            rg::uploadUniformBlock(frameRing, lights, offsetof(rg::glsl::Lights, pointLights) +
+                                                  programState->pointLights.size() * sizeof(PointLight));
+
+            // features are compiled into the variant, the maps of each material add their own
+            rg::ShaderVariant litVariant;
+            litVariant.pointLights = (unsigned)programState->pointLights.size();
+            if (programState->gamma)
+                litVariant.features |= rg::SHADER_GAMMA;
+            if (programState->fog)
+                litVariant.features |= rg::SHADER_FOG;
+            litShaders.beginFrame();
+            litDraws.clear();
+
+            // containers
+            const Mesh& container = programState->gamma ? containerMeshGamma : containerMesh;
+            for (unsigned int i = 0; i < scene.containers.size(); i++) {
+                // calculate the model matrix for each object
+                glm::mat4 model = glm::mat4(1.0f);
+                model = glm::translate(model, scene.containers[i]);
+                float angle = 20.0f * i;
+                if(i%3 == 1) {
+                    angle = (1+sin(glfwGetTime()))/2 * 30.0f;
+                }
+                if(i%3 == 2) {
+                    angle = (1+cos(glfwGetTime()))/2 * 30.0f;
+                }
+
+                model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
+                container.Queue(litDraws, model);
             }
 
-            model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-            lightingShader.setMat4("model", model);
+            // rock models
+            if (programState->staticBatching)
+                staticScene.Queue(litDraws, clusters);
+            for (unsigned int i = 0; i < scene.rocks.size() && !programState->staticBatching; i++) {
+                model = glm::mat4(1.0f);
+                model = glm::translate(model, scene.rocks[i]);
+                model = glm::scale(model, glm::vec3(1.1f));
+                rockModel.QueueLod(litDraws, model, lodView, programState->rockLods[i], clusters);
+            }
+            // bow model
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(programState->camera.Position.x-0.15, programState->camera.Position.y, programState->camera.Position.z-1));
+            model = glm::rotate(model, (float)(M_PI/2.0) ,glm::vec3(1.0f,0.0f,0.0f));
+            model = glm::scale(model,glm::vec3(0.2f));
+            bowModel.Queue(litDraws, model, clusters);
+
+            // dragon models
+            for (unsigned int i = 0; i < scene.dragons.size(); i++) {
+                model = glm::mat4(1.0f);
+                model = glm::translate(model, scene.dragons[i]);
+                model = glm::scale(model, glm::vec3(programState->dragonScale));
+                dragonModel.QueueLod(litDraws, model, lodView, programState->dragonLods[i], clusters);
+            }
 
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+            litDraws.build(culling.cpuFrustum(), culling.cpuEye());
+            litDraws.upload(frameRing);
+            if (rg::glInfo().multiDrawIndirect && litInstancesGeneration != frameRing.generation()) {
+                meshGeometry.attachInstances<MeshInstanceFormat>(frameRing.buffer());
+                litInstancesGeneration = frameRing.generation();
+            }
+            {
+                rg::GpuScope cullPass(gpuProfiler, "Culling");
+                culling.dispatch(litDraws, frameRing);
+            }
+            // one call per material, independent of the number of objects
+            DrawQueued(litDraws, meshGeometry, litShaders, litVariant, &culling);
         }
 
-        // we can use same shader program for rendering rock models
-        for (unsigned int i = 0; i < 4; i++) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, rockPositions[i]);
-            model = glm::scale(model, glm::vec3(1.1f));
-            lightingShader.setMat4("model", model);
-            rockModel.Draw(lightingShader);
-        }
-        // bow model
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(programState->camera.Position.x-0.15, programState->camera.Position.y, programState->camera.Position.z-1));
-        model = glm::rotate(model, (float)(M_PI/2.0) ,glm::vec3(1.0f,0.0f,0.0f));
-        model = glm::scale(model,glm::vec3(0.2f));
-        lightingShader.setMat4("model",model);
-        bowModel.Draw(lightingShader);
-
-        // dragon model
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, programState->dragonPosition);
-        model = glm::scale(model, glm::vec3(programState->dragonScale));
-        lightingShader.setMat4("model",model);
-        dragonModel.Draw(lightingShader);
-
-        // also draw the lamp object(s)
-        lightCubeShader.use();
-        lightCubeShader.setMat4("projection", projection);
-        lightCubeShader.setMat4("view", view);
-
-        // we now draw as many light bulbs as we have point lights.
-        glBindVertexArray(lightCubeVAO);
-        for (unsigned int i = 0; i < 4; i++) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, dynamicPointLightsPositions[i]);
-            model = glm::scale(model, glm::vec3(0.2f)); // Make it a smaller cube
-            lightCubeShader.setMat4("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+        {
+            rg::GpuScope pass(gpuProfiler, "Light cubes");
+            PROFILE_ZONE("Light cubes");
+            // also draw the lamp object(s)
+            lightCubeShader.use();
+
+            // we now draw as many light bulbs as we have point lights.
+            bool batched = programState->dynamicBatching && lightCubeBatch.accepts(lightCubeMesh);
+            rg::gl::BindVertexArray(lightCubeVAO);
+            for (unsigned int i = 0; i < dynamicPointLightsPositions.size(); i++) {
+                model = glm::mat4(1.0f);
+                model = glm::translate(model, dynamicPointLightsPositions[i]);
+                model = glm::scale(model, glm::vec3(0.2f)); // Make it a smaller cube
+                if (batched) {
+                    lightCubeBatch.add(lightCubeMesh, model);
+                    continue;
+                }
+                lightCubeShader.setMat4("model", model);
+                rg::gl::DrawArrays(GL_TRIANGLES, 0, 36);
+            }
+            if (batched)
+                lightCubeShader.setMat4("model", glm::mat4(1.0f));
+            lightCubeBatch.draw();
         }
-        // enable shader before setting uniforms
-        targetShader.use();
-        targetShader.setMat4("projection", projection);
-        targetShader.setMat4("view", view);
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, targetTexture);
 
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, targetTexture1);
+        {
+            rg::GpuScope pass(gpuProfiler, "Targets");
+            PROFILE_ZONE("Targets");
+            // enable shader before setting uniforms
+            targetShader.use();
 
-        glBindVertexArray(VAO1);
-        for (unsigned int i = 0; i < 2; i++) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3((float)i*5,2.0f,-18.0f));
-            model = glm::scale(model, glm::vec3(1.5f));
-            targetShader.setMat4("model", model);
-            glDrawElements(GL_TRIANGLES,6,GL_UNSIGNED_INT,0);
+            glActiveTexture(GL_TEXTURE0);
+            rg::gl::BindTexture(GL_TEXTURE_2D, targetTexture);
+
+            glActiveTexture(GL_TEXTURE1);
+            rg::gl::BindTexture(GL_TEXTURE_2D, targetTexture1);
+
+            bool batched = programState->dynamicBatching && targetBatch.accepts(targetMesh);
+            rg::gl::BindVertexArray(VAO1);
+            for (unsigned int i = 0; i < 2; i++) {
+                model = glm::mat4(1.0f);
+                model = glm::translate(model, glm::vec3((float)i*5,2.0f,-18.0f));
+                model = glm::scale(model, glm::vec3(1.5f));
+                if (batched) {
+                    targetBatch.add(targetMesh, model);
+                    continue;
+                }
+                targetShader.setMat4("model", model);
+                rg::gl::DrawElements(GL_TRIANGLES,6,GL_UNSIGNED_INT,0);
+            }
+            if (batched)
+                targetShader.setMat4("model", glm::mat4(1.0f));
+            targetBatch.draw();
         }
 
-        // now draw the skybox
-        if(programState->skyBoxEnabled) {
-            glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
-            skyboxShader.use();
-            glm::mat4 view1 = glm::mat4(glm::mat3(view)); // remove translation from the view matrix
-            skyboxShader.setMat4("view", view1);
-            skyboxShader.setMat4("projection", projection);
-            // skybox cube
-            glBindVertexArray(skyboxVAO);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-            glBindVertexArray(0);
-            glDepthFunc(GL_LESS); // set depth function back to default
+        // the opaque depth is complete, next frame's occlusion culling tests against it
+        if (culling.wantsHiZ()) {
+            rg::GpuScope pass(gpuProfiler, "Hi-Z pyramid");
+            PROFILE_ZONE("Hi-Z pyramid");
+            hiZ.build(framebufferWidth, framebufferHeight, projection * view);
+        } else {
+            hiZ.invalidate();
         }
 
-        // at the end draw blending objects
-        windowShader.use();
-        windowShader.setMat4("projection", projection);
-        windowShader.setMat4("view", view);
+        {
+            rg::GpuScope pass(gpuProfiler, "Skybox");
+            PROFILE_ZONE("Skybox");
+            // now draw the skybox
+            if(programState->skyBoxEnabled) {
+                glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
+                skyboxShader.use();
+                // skybox cube
+                rg::gl::BindVertexArray(skyboxVAO);
+                glActiveTexture(GL_TEXTURE0);
+                rg::gl::BindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+                rg::gl::DrawArrays(GL_TRIANGLES, 0, 36);
+                rg::gl::BindVertexArray(0);
+                glDepthFunc(GL_LESS); // set depth function back to default
+            }
+        }
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, windowTexture);
-        glBindVertexArray(windowVAO);
+        {
+            rg::GpuScope pass(gpuProfiler, "Windows");
+            PROFILE_ZONE("Windows");
+            // at the end draw blending objects
+            windowShader.use();
 
-        for (const glm::vec3& w : windowPositions) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model,w);
-            model = glm::scale(model, glm::vec3(3.0f));
-            windowShader.setMat4("model", model);
-            glDrawArrays(GL_TRIANGLES, 0 ,6);
+            glActiveTexture(GL_TEXTURE0);
+            rg::gl::BindTexture(GL_TEXTURE_2D, windowTexture);
+            rg::gl::BindVertexArray(windowVAO);
+
+            // the batch keeps the back to front order
+            bool batched = programState->dynamicBatching && windowBatch.accepts(windowMesh);
+            for (unsigned int i = 0; i < windowCount; i++) {
+                model = glm::mat4(1.0f);
+                model = glm::translate(model, scene.windows[windowOrder[i].index]);
+                model = glm::scale(model, glm::vec3(3.0f));
+                if (batched) {
+                    windowBatch.add(windowMesh, model);
+                    continue;
+                }
+                windowShader.setMat4("model", model);
+                rg::gl::DrawArrays(GL_TRIANGLES, 0 ,6);
+            }
+            if (batched)
+                windowShader.setMat4("model", glm::mat4(1.0f));
+            windowBatch.draw();
+        }
+        frameRing.endFrame();
+        programState->dynamicCopies = unsigned(lightCubeBatch.copyCount() + targetBatch.copyCount() + windowBatch.copyCount());
+        programState->dynamicDraws = unsigned(lightCubeBatch.drawCount() + targetBatch.drawCount() + windowBatch.drawCount());
+
+        {
+            rg::GpuScope pass(gpuProfiler, "ImGui");
+            PROFILE_ZONE("ImGui");
+            if (programState->ImGuiEnabled)
+                DrawImGui(programState);
         }
 
-        if (programState->ImGuiEnabled)
-            DrawImGui(programState);
+        gpuProfiler.endFrame();
+        rg::RenderStats::endFrame();
+        rg::AllocationTracker::endFrame();
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        glfwSwapBuffers(window);
+        {
+            PROFILE_ZONE("Swap buffers");
+            glfwSwapBuffers(window);
+        }
         glfwPollEvents();
     }
 
+    if (programState->sweep.results.size() > 0 && !programState->exitAfterSweep && !programState->benchmarkOutput.empty())
+        programState->sweep.writeJson(programState->benchmarkOutput);
+
+    int exitCode = 0;
+    if (options.checkAllocations) {
+        for (const rg::BenchmarkResult& r : programState->sweep.results) {
+            if (r.maxAllocations > 0) {
+                std::cerr << "Steady state frames allocate: up to " << r.maxAllocations << " allocations per frame with "
+                          << r.config.containers << " containers, " << r.config.lights << " lights\n";
+                exitCode = 1;
+            }
+        }
+    }
+
+    gpuProfiler.destroy();
+    programState->frameRing.destroy();
+    rg::textureUploader().destroy();
+    shaders.destroy();
+    rg::Profiler::writeChromeTrace(options.traceOutput);
+    if (!options.statsOutput.empty())
+        rg::RenderStats::writeCsv(options.statsOutput);
     delete programState;
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
-    // glfw: terminate, clearing all previously allocated GLFW resources.
+    // the models free their own GL objects, glfwTerminator ends GLFW after them
     // ------------------------------------------------------------------
-    glDeleteVertexArrays(1, &cubeVAO);
     glDeleteVertexArrays(1, &lightCubeVAO);
     glDeleteVertexArrays(1, &VAO1);
     glDeleteVertexArrays(1,&windowVAO);
@@ -689,8 +877,8 @@ int main() {
     glDeleteBuffers(1, &windowVBO);
     glDeleteBuffers(1,&skyboxVBO);
 
-    glfwTerminate();
-    return 0;
+    rg::DebugOutput::report();
+    return exitCode;
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
@@ -751,10 +939,200 @@ void DrawImGui(ProgramState *programState) {
         ImGui::End();
     }
 
+    {
+        ImGui::Begin("Shading");
+        ImGui::Checkbox("Gamma correction", &programState->gamma);
+        ImGui::Checkbox("Fog", &programState->fog);
+        ImGui::DragFloat("Fog density", &programState->fogDensity, 0.001f, 0.0f, 0.5f);
+        ImGui::Text("Lit shader variants: %u", programState->litShaderVariants);
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Culling");
+        int mode = (int)programState->culling;
+        ImGui::RadioButton("Off", &mode, (int)rg::CullMode::Off);
+        ImGui::RadioButton("Frustum", &mode, (int)rg::CullMode::Frustum);
+        // occlusion needs the compute path, on the CPU it is the frustum test
+        ImGui::RadioButton("Frustum + Hi-Z", &mode, (int)rg::CullMode::HiZ);
+        programState->culling = (rg::CullMode)mode;
+        // meshlets off screen or facing away are culled on their own, big meshes draw in parts
+        ImGui::Checkbox("Meshlets (frustum + normal cone)", &programState->clusterCulling);
+        ImGui::Text(programState->gpuCulling ? "Culling on the GPU (compute)" : "Culling on the CPU (no compute shaders)");
+        ImGui::End();
+    }
+
+    {
+        rg::LodView& lod = programState->lod;
+        ImGui::Begin("Level of detail");
+        ImGui::Checkbox("Simplified meshes", &lod.enabled);
+        ImGui::DragFloat("Max error (px)", &lod.maxErrorPixels, 0.05f, 0.1f, 20.0f);
+        ImGui::DragFloat("Hysteresis", &lod.hysteresis, 0.01f, 0.0f, 0.9f);
+        // contribution culling works with the simplified meshes off as well
+        ImGui::DragFloat("Min size (px)", &lod.minSizePixels, 0.1f, 0.0f, 50.0f);
+        // index 0 counts the culled instances, level l is at l + 1; fixed size so the window doesn't allocate
+        unsigned levels[rg::MAX_LOD_LEVELS + 1] = {};
+        int highest = -1;
+        auto count = [&levels, &highest](int level, unsigned instances) {
+            level = std::min(level, rg::MAX_LOD_LEVELS - 1);
+            highest = std::max(highest, level);
+            levels[level + 1] += instances;
+        };
+        for (int level : programState->rockLods)
+            count(level, !programState->staticBatching);
+        for (int level : programState->dragonLods)
+            count(level, 1);
+        ImGui::Text("Culled %u", levels[0]);
+        for (int level = 0; level <= highest; ++level) {
+            ImGui::SameLine();
+            ImGui::Text("LOD%d %u", level, levels[level + 1]);
+        }
+        ImGui::End();
+    }
+
+    {
+        rg::SceneConfig& config = programState->sceneConfig;
+        ImGui::Begin("Scene generator");
+        ImGui::DragScalar("Containers", ImGuiDataType_U32, &config.containers, 1.0f);
+        ImGui::DragScalar("Rocks", ImGuiDataType_U32, &config.rocks, 1.0f);
+        ImGui::DragScalar("Point lights", ImGuiDataType_U32, &config.lights, 0.2f);
+        ImGui::DragScalar("Windows", ImGuiDataType_U32, &config.windows, 1.0f);
+        ImGui::DragScalar("Dragons", ImGuiDataType_U32, &config.dragons, 0.2f);
+        ImGui::Checkbox("Static batching", &programState->staticBatching);
+        ImGui::Text("%u rock meshes in %u batches", programState->staticCopies, programState->staticBatches);
+        ImGui::Checkbox("Dynamic batching", &programState->dynamicBatching);
+        ImGui::DragScalar("Max batched vertices", ImGuiDataType_U32, &programState->dynamicBatchMaxVertices, 1.0f);
+        ImGui::Text("%u small meshes in %u draws", programState->dynamicCopies, programState->dynamicDraws);
+        ImGui::DragScalar("Seed", ImGuiDataType_U32, &config.seed, 1.0f);
+        ImGui::DragFloat("Extent", &config.extent, 0.1f, 1.0f, 200.0f);
+        ImGui::Checkbox("Random layout", &config.randomLayout);
+        if (ImGui::Button("Regenerate"))
+            programState->sceneDirty = true;
+
+        ImGui::Separator();
+        ImGui::InputText("Sweep", programState->sweepSpec, sizeof(programState->sweepSpec));
+        rg::SceneSweep& sweep = programState->sweep;
+        if (sweep.isActive()) {
+            ImGui::Text("Running configuration %zu / %zu", sweep.currentIndex() + 1, sweep.size());
+        } else if (ImGui::Button("Run sweep")) {
+            // several specifications can be separated by spaces, e.g. "containers=10,100 lights=4,32"
+            std::vector<std::string> specs;
+            std::stringstream ss(programState->sweepSpec);
+            std::string spec;
+            while (ss >> spec)
+                specs.push_back(spec);
+            StartSweep(programState, specs);
+        }
+        for (const rg::BenchmarkResult& r : sweep.results)
+            ImGui::Text("%u/%u/%u/%u/%u: %.2f ms (p95 %.2f ms)", r.config.containers, r.config.rocks,
+                        r.config.lights, r.config.windows, r.config.dragons, r.avgMs, r.p95Ms);
+        ImGui::End();
+    }
+
+    {
+        const rg::GpuProfiler& profiler = programState->gpuProfiler;
+        ImGui::Begin("GPU timings");
+        for (unsigned int i = 0; i < profiler.passCount(); ++i) {
+            char overlay[32];
+            snprintf(overlay, sizeof(overlay), "%.3f ms", profiler.lastMs(i));
+            ImGui::PlotLines(profiler.passName(i), profiler.historyMs(i), rg::GPU_TIMER_HISTORY,
+                             profiler.historyStart(), overlay, 0.0f, FLT_MAX, ImVec2(0, 40));
+        }
+        ImGui::End();
+    }
+
+    {
+        const rg::FrameStats& stats = rg::RenderStats::lastFrame();
+        ImGui::Begin("Render stats");
+        ImGui::Text("Draw calls:        %llu", (unsigned long long)stats.drawCalls);
+        ImGui::Text("Triangles:         %llu", (unsigned long long)stats.triangles);
+        ImGui::Text("Program binds:     %llu", (unsigned long long)stats.programBinds);
+        ImGui::Text("VAO binds:         %llu", (unsigned long long)stats.vertexArrayBinds);
+        ImGui::Text("Texture binds:     %llu", (unsigned long long)stats.textureBinds);
+        ImGui::Text("Uniform uploads:   %llu", (unsigned long long)stats.uniformUploads);
+        ImGui::Text("Buffer bytes:      %llu", (unsigned long long)stats.bufferBytes);
+        ImGui::Text("Texture bytes:     %llu", (unsigned long long)stats.textureBytes);
+        if (programState->meshGeometry) {
+            const rg::RangeAllocator& vertices = programState->meshGeometry->vertexAllocator();
+            const rg::RangeAllocator& indices = programState->meshGeometry->indexAllocator();
+            ImGui::Text("Mesh pool:         %u / %u vertices, %u / %u indices", vertices.used(), vertices.capacity(),
+                        indices.used(), indices.capacity());
+        }
+        const rg::StreamBuffer& ring = programState->frameRing;
+        ImGui::Text("Frame ring:        %zu / %zu KB, %u frames%s", ring.frameUsage() / 1024, ring.frameSize() / 1024,
+                    ring.framesInFlight(), ring.isPersistent() ? ", persistent" : "");
+        ImGui::Text("Ring waits:        %llu", (unsigned long long)ring.stalls());
+        const rg::TextureUploader& uploader = rg::textureUploader();
+        ImGui::Text("Texture uploads:   %zu pending, %zu / %zu KB", uploader.pending(),
+                    uploader.lastUploadBytes() / 1024, uploader.frameBudget() / 1024);
+        if (ImGui::Button("Export CSV"))
+            rg::RenderStats::writeCsv("render_stats.csv");
+        ImGui::End();
+    }
+
+    {
+        const rg::AllocationCounters& frame = rg::AllocationTracker::lastFrame();
+        const rg::AllocationCounters& worst = rg::AllocationTracker::worstFrame();
+        const rg::LinearAllocator& arena = programState->frameArena;
+        ImGui::Begin("Allocations");
+        ImGui::Text("Last frame:   %llu allocations, %llu frees, %llu bytes", (unsigned long long)frame.allocations,
+                    (unsigned long long)frame.frees, (unsigned long long)frame.bytes);
+        ImGui::Text("Render thread: %llu allocations", (unsigned long long)rg::AllocationTracker::lastFrameRenderThread());
+        ImGui::Text("Worst frame:  %llu allocations, %llu bytes", (unsigned long long)worst.allocations,
+                    (unsigned long long)worst.bytes);
+        if (ImGui::Button("Reset worst frame"))
+            rg::AllocationTracker::resetWorstFrame();
+        ImGui::Text("Frame arena:  %zu / %zu bytes (high water %zu, overflow %zu)", arena.used(), arena.size(),
+                    arena.highWaterMark(), arena.overflowBytes());
+        ImGui::End();
+    }
+
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
+void BuildScene(ProgramState *programState) {
+    PROFILE_FUNCTION();
+    programState->scene = rg::SceneGenerator::generate(programState->sceneConfig, programState->dragonPosition);
+    programState->sceneDirty = false;
+
+    const vector<glm::vec3>& positions = programState->scene.pointLights;
+    programState->pointLights.resize(positions.size());
+    for (unsigned int i = 0; i < positions.size(); i++) {
+        PointLight& pointLight = programState->pointLights[i];
+        pointLight.position = positions[i];
+        pointLight.ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+        pointLight.diffuse = glm::vec3(0.8f, 0.8f, 0.8f);
+        pointLight.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+
+        pointLight.constant = 1.0f;
+        pointLight.linear = 0.09f;
+        pointLight.quadratic = 0.032f;
+    }
+}
+
+void SetLightingUniforms(Shader &shader, ProgramState *programState) {
+    shader.setInt("material.texture_diffuse1", 0);
+    shader.setInt("material.texture_specular1", 1);
+    shader.setFloat("material.shininess", programState->materialShininess);
+
+    if (programState->fog) {
+        shader.setVec3("fogColor", programState->clearColor);
+        shader.setFloat("fogDensity", programState->fogDensity);
+    }
+}
+
+// false when the specifications are invalid, the error is printed
+bool StartSweep(ProgramState *programState, const std::vector<std::string> &specs) {
+    std::vector<rg::SceneConfig> configs;
+    if (!rg::expandSweep(programState->sceneConfig, specs, configs) || configs.empty())
+        return false;
+    programState->sweep.start(configs);
+    programState->sceneConfig = programState->sweep.currentConfig();
+    programState->sceneDirty = true;
+    return true;
+}
+
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
     if (key == GLFW_KEY_R && action == GLFW_RELEASE && !programState->skyBoxEnabled) {
         std::cerr << "Change clear color to RED\n";
@@ -797,6 +1175,14 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
             std::cerr << "Skybox disabled\n";
     }
 
+    if (key == GLFW_KEY_F3 && action == GLFW_PRESS) {
+        programState->fog = !programState->fog;
+        if (programState->fog)
+            std::cerr << "Fog enabled\n";
+        else
+            std::cerr << "Fog disabled\n";
+    }
+
     if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) {
         programState->gamma = !programState->gamma;
         if(programState->gamma)
@@ -806,66 +1192,11 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
     }
 }
 
+// RGBA textures are clamped to the edge, important for blending
 unsigned int loadTexture(char const * path, bool gammaCorrection) {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum internalFormat;
-        GLenum dataFormat;
-        if (nrComponents == 1)
-            internalFormat = dataFormat = GL_RED;
-        else if (nrComponents == 3) {
-            internalFormat = gammaCorrection ? GL_SRGB : GL_RGB;
-            dataFormat = GL_RGB;
-        }
-        else if (nrComponents == 4) {
-            internalFormat = gammaCorrection ? GL_SRGB_ALPHA : GL_RGBA;
-            dataFormat = GL_RGBA;
-        }
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, dataFormat, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        // important for blending
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, dataFormat == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, dataFormat == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-    return textureID;
+    return rg::textureUploader().load2D(path, gammaCorrection, true);
 }
 
 unsigned int loadCubemap(vector<std::string> faces) {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++) {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data) {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
+    return rg::textureUploader().loadCubemap(faces);
 }
@@ -0,0 +1,462 @@
+// Build step: reads the std140 uniform blocks of the given shaders and writes a header with a
+// C++ struct for every block and every GLSL struct used in one. Each member gets a
+// static_assert on its std140 offset, each block a constexpr binding index, so a block is
+// filled with one memcpy-like upload and any layout mismatch fails the build.
+//
+// usage: shader_reflect <output header> <shader>...
+//
+// Only what the shaders in this project use is understood: `struct Name { ... };`,
+// `layout (std140) uniform Name { ... };`, scalar/vector/matrix members, arrays sized by a
+// number or by a `#define NAME number` from the same file. Other preprocessor lines are
+// ignored, so members of a block must not depend on #ifdefs.
+//
+// Shaders that are also loaded as SPIR-V (include/rg/SpirvModules.h) can't be asked for names,
+// they give their blocks a `BINDING(n)` in the layout and their default block uniforms a
+// `LOCATION(n)`, both macros defined in the shader. A block keeps an explicit binding, the
+// others get the lowest free ones. The locations are written to a table, a struct uniform's
+// members following each other from its location.
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Member {
+    std::string type;
+    std::string name;
+    unsigned arraySize = 0; // 0 when not an array
+    unsigned offset = 0;
+};
+
+struct Struct {
+    std::string name;
+    std::vector<Member> members;
+    unsigned size = 0;
+    unsigned alignment = 16;
+    bool isBlock = false;
+    // explicit BINDING(n) or binding = n, -1 when the generator picks one
+    int binding = -1;
+    std::string source;
+};
+
+// LOCATION(n) uniform type name;
+struct Uniform {
+    std::string source;
+    std::string type;
+    std::string name;
+    unsigned location = 0;
+};
+
+struct TypeInfo {
+    unsigned size;
+    unsigned alignment;
+    const char* cppType;
+};
+
+// std140 base alignment and size, matrices are arrays of vec4 columns
+const std::map<std::string, TypeInfo> BASIC_TYPES = {
+        {"float", {4, 4, "float"}},
+        {"int", {4, 4, "int32_t"}},
+        {"uint", {4, 4, "uint32_t"}},
+        {"bool", {4, 4, "uint32_t"}},
+        {"vec2", {8, 8, "glm::vec2"}},
+        {"vec3", {12, 16, "glm::vec3"}},
+        {"vec4", {16, 16, "glm::vec4"}},
+        {"ivec2", {8, 8, "glm::ivec2"}},
+        {"ivec3", {12, 16, "glm::ivec3"}},
+        {"ivec4", {16, 16, "glm::ivec4"}},
+        {"mat3", {48, 16, "glm::vec4[3]"}},
+        {"mat4", {64, 16, "glm::mat4"}},
+};
+
+unsigned roundUp(unsigned value, unsigned alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+[[noreturn]] void fail(const std::string& file, const std::string& message) {
+    std::cerr << file << ": " << message << '\n';
+    std::exit(1);
+}
+
+class Parser {
+public:
+    Parser(std::string file, const std::string& text) : file(std::move(file)) { tokenize(text); }
+
+    void parse(std::map<std::string, Struct>& structs, std::vector<std::string>& order, std::vector<Uniform>& uniforms) {
+        while (position < tokens.size()) {
+            if (accept("struct")) {
+                Struct s = parseBody(next());
+                expect(";");
+                add(structs, order, s);
+            } else if (accept("LOCATION")) {
+                Uniform uniform;
+                uniform.source = file;
+                expect("(");
+                uniform.location = number(next());
+                expect(")");
+                expect("uniform");
+                uniform.type = next();
+                uniform.name = next();
+                expect(";");
+                uniforms.push_back(uniform);
+            } else if (accept("layout")) {
+                expect("(");
+                bool std140 = false;
+                int binding = -1;
+                for (int depth = 1; depth > 0;) {
+                    const std::string& token = next();
+                    if (token == "(") {
+                        ++depth;
+                    } else if (token == ")") {
+                        --depth;
+                    } else if (token == "std140") {
+                        std140 = true;
+                    } else if (token == "BINDING") {
+                        expect("(");
+                        binding = (int)number(next());
+                        expect(")");
+                    } else if (token == "binding") {
+                        expect("=");
+                        binding = (int)number(next());
+                    }
+                }
+                if (!accept("uniform"))
+                    continue;
+                std::string name = next();
+                if (!std140)
+                    fail(file, "uniform block " + name + " has to be layout (std140)");
+                Struct s = parseBody(name);
+                s.isBlock = true;
+                s.binding = binding;
+                if (!accept(";")) {
+                    next(); // instance name
+                    expect(";");
+                }
+                add(structs, order, s);
+            } else {
+                ++position;
+            }
+        }
+    }
+
+private:
+    std::string file;
+    std::vector<std::string> tokens;
+    std::map<std::string, unsigned> defines;
+    size_t position = 0;
+
+    void tokenize(const std::string& text) {
+        size_t i = 0;
+        while (i < text.size()) {
+            char c = text[i];
+            if (std::isspace((unsigned char)c)) {
+                ++i;
+            } else if (text.compare(i, 2, "//") == 0) {
+                i = text.find('\n', i);
+            } else if (text.compare(i, 2, "/*") == 0) {
+                size_t end = text.find("*/", i + 2);
+                i = end == std::string::npos ? text.size() : end + 2;
+            } else if (c == '#') {
+                size_t end = text.find('\n', i);
+                std::istringstream line(text.substr(i + 1, end == std::string::npos ? std::string::npos : end - i - 1));
+                std::string directive, name, value;
+                line >> directive >> name >> value;
+                if (directive == "define" && !value.empty() && std::isdigit((unsigned char)value[0]))
+                    defines[name] = (unsigned)std::strtoul(value.c_str(), nullptr, 10);
+                i = end;
+            } else if (std::isalnum((unsigned char)c) || c == '_') {
+                size_t start = i;
+                while (i < text.size() && (std::isalnum((unsigned char)text[i]) || text[i] == '_'))
+                    ++i;
+                tokens.push_back(text.substr(start, i - start));
+            } else {
+                tokens.push_back(std::string(1, c));
+                ++i;
+            }
+        }
+    }
+
+    unsigned number(const std::string& token) {
+        if (token.empty() || !std::isdigit((unsigned char)token[0]))
+            fail(file, "expected a number instead of " + token);
+        return (unsigned)std::strtoul(token.c_str(), nullptr, 10);
+    }
+
+    const std::string& next() {
+        if (position >= tokens.size())
+            fail(file, "unexpected end of file");
+        return tokens[position++];
+    }
+
+    bool accept(const char* token) {
+        if (position < tokens.size() && tokens[position] == token) {
+            ++position;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(const char* token) {
+        if (!accept(token))
+            fail(file, std::string("expected ") + token + " before " + (position < tokens.size() ? tokens[position] : "end"));
+    }
+
+    Struct parseBody(const std::string& name) {
+        Struct s;
+        s.name = name;
+        s.source = file;
+        expect("{");
+        while (!accept("}")) {
+            std::string type = next();
+            while (type == "highp" || type == "mediump" || type == "lowp")
+                type = next();
+            do {
+                Member member;
+                member.type = type;
+                member.name = next();
+                if (accept("[")) {
+                    std::string size = next();
+                    if (defines.count(size))
+                        member.arraySize = defines[size];
+                    else if (std::isdigit((unsigned char)size[0]))
+                        member.arraySize = (unsigned)std::strtoul(size.c_str(), nullptr, 10);
+                    else
+                        fail(file, "array size " + size + " of " + member.name + " is not a number or a #define");
+                    expect("]");
+                }
+                s.members.push_back(member);
+            } while (accept(","));
+            expect(";");
+        }
+        return s;
+    }
+
+    void add(std::map<std::string, Struct>& structs, std::vector<std::string>& order, const Struct& s) {
+        auto it = structs.find(s.name);
+        if (it == structs.end()) {
+            structs[s.name] = s;
+            order.push_back(s.name);
+            return;
+        }
+        if (s.binding >= 0 && it->second.binding >= 0 && s.binding != it->second.binding)
+            fail(file, s.name + " is bound to " + std::to_string(it->second.binding) + " in " + it->second.source);
+        if (s.binding >= 0)
+            it->second.binding = s.binding;
+        bool same = it->second.members.size() == s.members.size() && it->second.isBlock == s.isBlock;
+        for (size_t i = 0; same && i < s.members.size(); ++i) {
+            const Member& a = it->second.members[i];
+            const Member& b = s.members[i];
+            same = a.type == b.type && a.name == b.name && a.arraySize == b.arraySize;
+        }
+        if (!same)
+            fail(file, s.name + " is declared differently in " + it->second.source);
+    }
+};
+
+class Generator {
+public:
+    explicit Generator(std::map<std::string, Struct>& structs) : structs(structs) {}
+
+    void layout(Struct& s) {
+        if (laidOut.count(s.name))
+            return;
+        laidOut[s.name] = true;
+        unsigned offset = 0;
+        unsigned alignment = 16;
+        for (Member& member : s.members) {
+            unsigned size, memberAlignment;
+            typeLayout(member.type, s.source, size, memberAlignment);
+            if (member.arraySize) {
+                // array elements are padded to a vec4 stride
+                memberAlignment = roundUp(memberAlignment, 16);
+                size = roundUp(size, 16) * member.arraySize;
+            }
+            offset = roundUp(offset, memberAlignment);
+            member.offset = offset;
+            offset += size;
+            alignment = std::max(alignment, memberAlignment);
+        }
+        s.alignment = alignment;
+        s.size = roundUp(offset, alignment);
+    }
+
+    std::string emit(const Struct& s) {
+        std::ostringstream out;
+        out << "// " << (s.isBlock ? "uniform block" : "struct") << " " << s.name << " in " << s.source << "\n";
+        out << "struct " << s.name << " {\n";
+        if (s.isBlock) {
+            out << "    static constexpr unsigned binding = " << s.binding << ";\n";
+            out << "    static const char* blockName() { return \"" << s.name << "\"; }\n\n";
+            bindings.push_back(s);
+        }
+        unsigned offset = 0;
+        unsigned padding = 0;
+        for (const Member& member : s.members) {
+            if (member.offset > offset)
+                out << "    float _pad" << padding++ << "[" << (member.offset - offset) / 4 << "];\n";
+            out << "    " << declaration(member) << ";\n";
+            unsigned size, alignment;
+            typeLayout(member.type, s.source, size, alignment);
+            offset = member.offset + (member.arraySize ? roundUp(size, 16) * member.arraySize : size);
+        }
+        if (s.size > offset)
+            out << "    float _pad" << padding++ << "[" << (s.size - offset) / 4 << "];\n";
+        out << "};\n";
+        out << "static_assert(sizeof(" << s.name << ") == " << s.size << ", \"std140 size of " << s.name << "\");\n";
+        for (const Member& member : s.members)
+            out << "static_assert(offsetof(" << s.name << ", " << member.name << ") == " << member.offset
+                << ", \"std140 offset of " << s.name << "::" << member.name << "\");\n";
+        return out.str();
+    }
+
+    const std::vector<Struct>& blockBindings() const { return bindings; }
+
+private:
+    std::map<std::string, Struct>& structs;
+    std::map<std::string, bool> laidOut;
+    std::vector<Struct> bindings;
+
+    void typeLayout(const std::string& type, const std::string& source, unsigned& size, unsigned& alignment) {
+        auto basic = BASIC_TYPES.find(type);
+        if (basic != BASIC_TYPES.end()) {
+            size = basic->second.size;
+            alignment = basic->second.alignment;
+            return;
+        }
+        auto nested = structs.find(type);
+        if (nested == structs.end() || nested->second.isBlock)
+            fail(source, "unsupported type " + type + " in a uniform block");
+        layout(nested->second);
+        size = nested->second.size;
+        alignment = nested->second.alignment;
+    }
+
+    std::string declaration(const Member& member) {
+        auto basic = BASIC_TYPES.find(member.type);
+        std::string type = basic != BASIC_TYPES.end() ? basic->second.cppType : member.type;
+        std::string suffix;
+        size_t bracket = type.find('[');
+        if (bracket != std::string::npos) {
+            suffix = type.substr(bracket);
+            type = type.substr(0, bracket);
+        }
+        bool padded = member.arraySize && basic != BASIC_TYPES.end() && basic->second.size % 16 != 0;
+        if (padded)
+            type = "std140::Padded<" + type + ">";
+        std::string array = member.arraySize ? "[" + std::to_string(member.arraySize) + "]" : "";
+        return type + " " + member.name + array + suffix;
+    }
+};
+
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "usage: shader_reflect <output header> <shader>...\n";
+        return 1;
+    }
+    std::map<std::string, Struct> structs;
+    std::vector<std::string> order;
+    std::vector<Uniform> uniforms;
+    for (int i = 2; i < argc; ++i) {
+        std::ifstream in(argv[i]);
+        if (!in)
+            fail(argv[i], "cannot open");
+        std::stringstream text;
+        text << in.rdbuf();
+        std::string path = argv[i];
+        size_t slash = path.find_last_of('/');
+        Parser(slash == std::string::npos ? path : path.substr(slash + 1), text.str()).parse(structs, order, uniforms);
+    }
+
+    // explicit bindings first, the other blocks take the lowest free ones in declaration order
+    std::set<int> taken;
+    for (const std::string& name : order) {
+        const Struct& s = structs[name];
+        if (s.isBlock && s.binding >= 0 && !taken.insert(s.binding).second)
+            fail(s.source, s.name + " shares binding " + std::to_string(s.binding) + " with another block");
+    }
+    int freeBinding = 0;
+    for (const std::string& name : order) {
+        Struct& s = structs[name];
+        if (!s.isBlock || s.binding >= 0)
+            continue;
+        while (taken.count(freeBinding))
+            ++freeBinding;
+        s.binding = freeBinding;
+        taken.insert(freeBinding);
+    }
+
+    // only the structs a block uses, in declaration order so nested structs come first
+    std::map<std::string, bool> used;
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+        const Struct& s = structs[*it];
+        if (!s.isBlock && !used.count(s.name))
+            continue;
+        for (const Member& member : s.members)
+            if (structs.count(member.type))
+                used[member.type] = true;
+    }
+
+    Generator generator(structs);
+    std::ostringstream body;
+    for (const std::string& name : order) {
+        Struct& s = structs[name];
+        if (!s.isBlock && !used.count(name))
+            continue;
+        generator.layout(s);
+        body << generator.emit(s) << '\n';
+    }
+
+    std::ostringstream out;
+    out << "// Generated by tools/ShaderReflect.cpp from the std140 uniform blocks in resources/shaders, do not edit.\n\n"
+        << "#ifndef PROJECT_BASE_SHADERBLOCKS_H\n#define PROJECT_BASE_SHADERBLOCKS_H\n\n"
+        << "namespace rg {\nnamespace glsl {\n\n" << body.str()
+        << "struct BlockBinding {\n    const char* name;\n    unsigned binding;\n};\n\n"
+        << "constexpr BlockBinding blockBindings[] = {\n";
+    for (const Struct& block : generator.blockBindings())
+        out << "    {\"" << block.name << "\", " << block.binding << "},\n";
+    if (generator.blockBindings().empty())
+        out << "    {nullptr, 0},\n";
+    out << "};\n\n"
+        << "// LOCATION(n) uniforms, looked up by name for programs loaded from SPIR-V\n"
+        << "struct UniformLocation {\n    const char* shader;\n    const char* name;\n    int location;\n};\n\n"
+        << "constexpr UniformLocation uniformLocations[] = {\n";
+    for (const Uniform& uniform : uniforms) {
+        auto s = structs.find(uniform.type);
+        if (s == structs.end()) {
+            out << "    {\"" << uniform.source << "\", \"" << uniform.name << "\", " << uniform.location << "},\n";
+            continue;
+        }
+        unsigned location = uniform.location;
+        for (const Member& member : s->second.members) {
+            if (member.arraySize || structs.count(member.type))
+                fail(uniform.source, uniform.name + "." + member.name + " needs a location of its own");
+            out << "    {\"" << uniform.source << "\", \"" << uniform.name << "." << member.name << "\", " << location++
+                << "},\n";
+        }
+    }
+    if (uniforms.empty())
+        out << "    {nullptr, nullptr, -1},\n";
+    out << "};\n\n};\n};\n\n#endif //PROJECT_BASE_SHADERBLOCKS_H\n";
+
+    // unchanged output keeps main.cpp from rebuilding
+    std::ifstream previous(argv[1]);
+    std::stringstream previousText;
+    previousText << previous.rdbuf();
+    if (previousText.str() == out.str())
+        return 0;
+    std::ofstream file(argv[1]);
+    if (!file)
+        fail(argv[1], "cannot write");
+    file << out.str();
+    return 0;
+}